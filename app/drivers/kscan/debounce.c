@@ -0,0 +1,89 @@
+/*
+ * Copyright (c) 2020 The ZMK Contributors
+ *
+ * SPDX-License-Identifier: MIT
+ */
+
+#include <kernel.h>
+
+#include "debounce.h"
+
+// Every key that differs from its pressed state counts how long its raw state has been stable.
+// A key only differs after a change of its raw state, which starts its count at 0.
+
+static uint16_t add_elapsed(uint16_t counter, uint32_t elapsed_ms) {
+    return MIN(counter + elapsed_ms, UINT16_MAX);
+}
+
+static uint16_t threshold(uint32_t key, uint32_t raw, const struct debounce_config *config) {
+    if (!(raw & BIT(key))) {
+        return config->release_ms;
+    }
+
+    return config->algorithm == DEBOUNCE_EAGER_PRESS ? 0 : config->press_ms;
+}
+
+static void update_keys(struct debounce_row *row, uint16_t *counters, uint32_t raw_changed,
+                        uint32_t pending, uint32_t elapsed_ms,
+                        const struct debounce_config *config) {
+    while (pending) {
+        int key = __builtin_ctz(pending);
+        pending &= pending - 1;
+
+        counters[key] = (raw_changed & BIT(key)) ? 0 : add_elapsed(counters[key], elapsed_ms);
+
+        if (counters[key] >= threshold(key, row->raw, config)) {
+            row->changed |= BIT(key);
+        }
+    }
+}
+
+// Any change restarts the count of the whole row, so all keys of the row that differ share the
+// same count. They change together once the longest of their periods passed.
+static void update_row(struct debounce_row *row, uint16_t *counters, uint32_t raw_changed,
+                       uint32_t pending, uint32_t elapsed_ms,
+                       const struct debounce_config *config) {
+    uint16_t row_threshold = 0;
+    uint16_t row_counter = 0;
+
+    for (uint32_t keys = pending; keys; keys &= keys - 1) {
+        int key = __builtin_ctz(keys);
+
+        counters[key] = raw_changed ? 0 : add_elapsed(counters[key], elapsed_ms);
+        row_counter = counters[key];
+        row_threshold = MAX(row_threshold, threshold(key, row->raw, config));
+    }
+
+    if (row_counter >= row_threshold) {
+        row->changed = pending;
+    }
+}
+
+void debounce_update_row(struct debounce_row *row, uint16_t *counters, uint32_t raw,
+                         uint32_t elapsed_ms, const struct debounce_config *config) {
+    uint32_t raw_changed = raw ^ row->raw;
+    uint32_t pending = raw ^ row->pressed;
+
+    row->raw = raw;
+    row->changed = 0;
+
+    if (!pending) {
+        return;
+    }
+
+    if (config->algorithm == DEBOUNCE_DEFERRED_PER_ROW) {
+        update_row(row, counters, raw_changed, pending, elapsed_ms, config);
+    } else {
+        update_keys(row, counters, raw_changed, pending, elapsed_ms, config);
+    }
+
+    row->pressed ^= row->changed;
+}
+
+uint32_t debounce_elapsed_ms(int64_t *last_update_at) {
+    int64_t now = k_uptime_get();
+    int64_t elapsed_ms = now - *last_update_at;
+
+    *last_update_at = now;
+    return MIN(elapsed_ms, UINT16_MAX);
+}
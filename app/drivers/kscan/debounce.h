@@ -0,0 +1,63 @@
+/*
+ * Copyright (c) 2020 The ZMK Contributors
+ *
+ * SPDX-License-Identifier: MIT
+ */
+
+#pragma once
+
+#include <zephyr/types.h>
+#include <stdbool.h>
+#include <sys/util.h>
+
+// In the order of the debounce-algorithm devicetree enum.
+enum debounce_algorithm {
+    // A key changes once its new state was read for the press or release period.
+    DEBOUNCE_DEFERRED,
+    // Presses are reported on the first read, releases are deferred.
+    DEBOUNCE_EAGER_PRESS,
+    // Like deferred, but the keys of a row only change once the whole row was stable.
+    DEBOUNCE_DEFERRED_PER_ROW,
+};
+
+struct debounce_config {
+    enum debounce_algorithm algorithm;
+    uint16_t press_ms;
+    uint16_t release_ms;
+    // Time between reads while keys are pressed or bouncing, at least 1ms.
+    uint16_t scan_period_ms;
+};
+
+// The debounced state of up to 32 keys read together, bit i for key i.
+struct debounce_row {
+    uint32_t raw;
+    uint32_t pressed;
+    // Keys whose pressed state changed in the last update.
+    uint32_t changed;
+};
+
+// The press, release and scan periods fall back to the debounce-period property.
+#define DEBOUNCE_INST_PERIOD_MS(n, prop)                                                           \
+    COND_CODE_1(DT_INST_NODE_HAS_PROP(n, prop), (DT_INST_PROP(n, prop)),                           \
+                (DT_INST_PROP(n, debounce_period)))
+
+#define DEBOUNCE_INST_CONFIG(n)                                                                    \
+    {                                                                                              \
+        .algorithm = DT_ENUM_IDX(DT_DRV_INST(n), debounce_algorithm),                              \
+        .press_ms = DEBOUNCE_INST_PERIOD_MS(n, debounce_press_ms),                                 \
+        .release_ms = DEBOUNCE_INST_PERIOD_MS(n, debounce_release_ms),                             \
+        .scan_period_ms = MAX(DEBOUNCE_INST_PERIOD_MS(n, debounce_scan_period_ms), 1),             \
+    }
+
+// Updates a row with the raw state that was read. counters holds one entry per key of the row,
+// elapsed_ms is the time since the previous update, see debounce_elapsed_ms().
+void debounce_update_row(struct debounce_row *row, uint16_t *counters, uint32_t raw,
+                         uint32_t elapsed_ms, const struct debounce_config *config);
+
+// Whether keys of the row are pressed or about to be, the row needs to be read again then.
+static inline bool debounce_row_is_active(const struct debounce_row *row) {
+    return (row->raw | row->pressed) != 0;
+}
+
+// Returns the time since the previous call with the same timestamp, and updates it.
+uint32_t debounce_elapsed_ms(int64_t *last_update_at);
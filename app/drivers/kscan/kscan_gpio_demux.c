@@ -11,6 +11,9 @@
 #include <drivers/gpio.h>
 #include <logging/log.h>
 
+#include "debounce.h"
+#include "poll_rate.h"
+
 LOG_MODULE_DECLARE(zmk, CONFIG_ZMK_LOG_LEVEL);
 
 #if DT_HAS_COMPAT_STATUS_OKAY(DT_DRV_COMPAT)
@@ -36,9 +39,6 @@ struct kscan_gpio_item_config {
 #define _KSCAN_GPIO_INPUT_CFG_INIT(idx, n) _KSCAN_GPIO_ITEM_CFG_INIT(n, input_gpios, idx)
 #define _KSCAN_GPIO_OUTPUT_CFG_INIT(idx, n) _KSCAN_GPIO_ITEM_CFG_INIT(n, output_gpios, idx)
 
-// Check debounce config
-#define CHECK_DEBOUNCE_CFG(n, a, b) COND_CODE_0(DT_INST_PROP(n, debounce_period), a, b)
-
 // Define the row and column lengths
 #define INST_MATRIX_INPUTS(n) DT_INST_PROP_LEN(n, input_gpios)
 #define INST_DEMUX_GPIOS(n) DT_INST_PROP_LEN(n, output_gpios)
@@ -47,7 +47,7 @@ struct kscan_gpio_item_config {
 
 #define GPIO_INST_INIT(n)                                                                          \
     struct kscan_gpio_irq_callback_##n {                                                           \
-        struct CHECK_DEBOUNCE_CFG(n, (k_work), (k_delayed_work)) * work;                           \
+        struct k_delayed_work *work;                                                               \
         struct gpio_callback callback;                                                             \
         const struct device *dev;                                                                  \
     };                                                                                             \
@@ -55,13 +55,18 @@ struct kscan_gpio_item_config {
     struct kscan_gpio_config_##n {                                                                 \
         struct kscan_gpio_item_config rows[INST_MATRIX_INPUTS(n)];                                 \
         struct kscan_gpio_item_config cols[INST_DEMUX_GPIOS(n)];                                   \
+        struct debounce_config debounce_config;                                                    \
     };                                                                                             \
                                                                                                    \
+    BUILD_ASSERT(INST_MATRIX_INPUTS(n) <= 32, "Demux kscan supports at most 32 inputs");           \
     struct kscan_gpio_data_##n {                                                                   \
         kscan_callback_t callback;                                                                 \
-        struct k_timer poll_timer;                                                                 \
-        struct CHECK_DEBOUNCE_CFG(n, (k_work), (k_delayed_work)) work;                             \
-        bool matrix_state[INST_MATRIX_INPUTS(n)][INST_MATRIX_OUTPUTS(n)];                          \
+        struct poll_rate poll_rate;                                                                \
+        struct k_delayed_work work;                                                                \
+        /* The debounced inputs of every output, bit i for input i. */                             \
+        struct debounce_row matrix_state[INST_MATRIX_OUTPUTS(n)];                                  \
+        uint16_t debounce_counters[INST_MATRIX_OUTPUTS(n)][INST_MATRIX_INPUTS(n)];                 \
+        int64_t last_read_at;                                                                      \
         const struct device *rows[INST_MATRIX_INPUTS(n)];                                          \
         const struct device *cols[INST_MATRIX_OUTPUTS(n)];                                         \
         const struct device *dev;                                                                  \
@@ -91,19 +96,14 @@ struct kscan_gpio_item_config {
         /* If row2col, rows = outputs & cols = inputs */                                           \
         return cfg->cols;                                                                          \
     }                                                                                              \
-    /* POLLING SETUP */                                                                            \
-    static void kscan_gpio_timer_handler(struct k_timer *timer) {                                  \
-        struct kscan_gpio_data_##n *data =                                                         \
-            CONTAINER_OF(timer, struct kscan_gpio_data_##n, poll_timer);                           \
-        k_work_submit(&data->work.work);                                                           \
-    }                                                                                              \
-                                                                                                   \
     /* Read the state of the input GPIOs */                                                        \
     /* This is the core matrix_scan func */                                                        \
     static int kscan_gpio_read_##n(const struct device *dev) {                                     \
-        bool submit_follow_up_read = false;                                                        \
+        bool active = false;                                                                       \
         struct kscan_gpio_data_##n *data = dev->data;                                              \
-        static bool read_state[INST_MATRIX_INPUTS(n)][INST_MATRIX_OUTPUTS(n)];                     \
+        const struct kscan_gpio_config_##n *cfg = dev->config;                                     \
+        static uint32_t read_state[INST_MATRIX_OUTPUTS(n)];                                        \
+        uint32_t elapsed_ms = debounce_elapsed_ms(&data->last_read_at);                            \
         for (int o = 0; o < INST_MATRIX_OUTPUTS(n); o++) {                                         \
             /* Iterate over bits and set GPIOs accordingly */                                      \
             for (uint8_t bit = 0; bit < INST_DEMUX_GPIOS(n); bit++) {                              \
@@ -114,32 +114,31 @@ struct kscan_gpio_item_config {
                 gpio_pin_set(out_dev, out_cfg->pin, state);                                        \
             }                                                                                      \
                                                                                                    \
+            read_state[o] = 0;                                                                     \
             for (int i = 0; i < INST_MATRIX_INPUTS(n); i++) {                                      \
                 /* Get the input device (port) */                                                  \
                 const struct device *in_dev = kscan_gpio_input_devices_##n(dev)[i];                \
                 /* Get the input device config (pin) */                                            \
                 const struct kscan_gpio_item_config *in_cfg =                                      \
                     &kscan_gpio_input_configs_##n(dev)[i];                                         \
-                read_state[i][o] = gpio_pin_get(in_dev, in_cfg->pin) > 0;                          \
+                WRITE_BIT(read_state[o], i, gpio_pin_get(in_dev, in_cfg->pin) > 0);                \
             }                                                                                      \
         }                                                                                          \
-        for (int r = 0; r < INST_MATRIX_INPUTS(n); r++) {                                          \
-            for (int c = 0; c < INST_MATRIX_OUTPUTS(n); c++) {                                     \
-                bool pressed = read_state[r][c];                                                   \
-                submit_follow_up_read = (submit_follow_up_read || pressed);                        \
-                if (pressed != data->matrix_state[r][c]) {                                         \
-                    LOG_DBG("Sending event at %d,%d state %s", r, c, (pressed ? "on" : "off"));    \
-                    data->matrix_state[r][c] = pressed;                                            \
-                    data->callback(dev, r, c, pressed);                                            \
-                }                                                                                  \
+        for (int c = 0; c < INST_MATRIX_OUTPUTS(n); c++) {                                         \
+            struct debounce_row *row = &data->matrix_state[c];                                     \
+            debounce_update_row(row, data->debounce_counters[c], read_state[c], elapsed_ms,        \
+                                &cfg->debounce_config);                                            \
+            active = active || debounce_row_is_active(row);                                        \
+            for (uint32_t changed = row->changed; changed; changed &= changed - 1) {               \
+                int r = __builtin_ctz(changed);                                                    \
+                bool pressed = row->pressed & BIT(r);                                              \
+                LOG_DBG("Sending event at %d,%d state %s", r, c, (pressed ? "on" : "off"));        \
+                data->callback(dev, r, c, pressed);                                                \
             }                                                                                      \
         }                                                                                          \
-        if (submit_follow_up_read) {                                                               \
-            CHECK_DEBOUNCE_CFG(n, ({ k_work_submit(&data->work); }), ({                            \
-                                   k_delayed_work_cancel(&data->work);                             \
-                                   k_delayed_work_submit(&data->work, K_MSEC(5));                  \
-                               }))                                                                 \
-        }                                                                                          \
+        /* Poll faster while keys are pressed or bouncing, and slower when idle. */                \
+        uint32_t next_read_ms = poll_rate_next_ms(&data->poll_rate, active, POLL_INTERVAL(n));     \
+        k_delayed_work_submit(&data->work, K_MSEC(next_read_ms));                                  \
         return 0;                                                                                  \
     }                                                                                              \
                                                                                                    \
@@ -167,9 +166,7 @@ struct kscan_gpio_item_config {
     static int kscan_gpio_enable_##n(const struct device *dev) {                                   \
         LOG_DBG("KSCAN API enable");                                                               \
         struct kscan_gpio_data_##n *data = dev->data;                                              \
-        /* TODO: we might want a follow up to hook into the sleep state hooks in Zephyr, */        \
-        /* and disable this timer when we enter a sleep state */                                   \
-        k_timer_start(&data->poll_timer, K_MSEC(POLL_INTERVAL(n)), K_MSEC(POLL_INTERVAL(n)));      \
+        k_delayed_work_submit(&data->work, K_NO_WAIT);                                             \
         return 0;                                                                                  \
     };                                                                                             \
                                                                                                    \
@@ -177,7 +174,7 @@ struct kscan_gpio_item_config {
     static int kscan_gpio_disable_##n(const struct device *dev) {                                  \
         LOG_DBG("KSCAN API disable");                                                              \
         struct kscan_gpio_data_##n *data = dev->data;                                              \
-        k_timer_stop(&data->poll_timer);                                                           \
+        k_delayed_work_cancel(&data->work);                                                        \
         return 0;                                                                                  \
     };                                                                                             \
                                                                                                    \
@@ -228,10 +225,7 @@ struct kscan_gpio_item_config {
         }                                                                                          \
         data->dev = dev;                                                                           \
                                                                                                    \
-        k_timer_init(&data->poll_timer, kscan_gpio_timer_handler, NULL);                           \
-                                                                                                   \
-        (CHECK_DEBOUNCE_CFG(n, (k_work_init), (k_delayed_work_init)))(                             \
-            &data->work, kscan_gpio_work_handler_##n);                                             \
+        k_delayed_work_init(&data->work, kscan_gpio_work_handler_##n);                             \
         return 0;                                                                                  \
     }                                                                                              \
                                                                                                    \
@@ -244,6 +238,7 @@ struct kscan_gpio_item_config {
     static const struct kscan_gpio_config_##n kscan_gpio_config_##n = {                            \
         .rows = {UTIL_LISTIFY(INST_MATRIX_INPUTS(n), _KSCAN_GPIO_INPUT_CFG_INIT, n)},              \
         .cols = {UTIL_LISTIFY(INST_DEMUX_GPIOS(n), _KSCAN_GPIO_OUTPUT_CFG_INIT, n)},               \
+        .debounce_config = DEBOUNCE_INST_CONFIG(n),                                                \
     };                                                                                             \
                                                                                                    \
     DEVICE_AND_API_INIT(kscan_gpio_##n, DT_INST_LABEL(n), kscan_gpio_init_##n,                     \
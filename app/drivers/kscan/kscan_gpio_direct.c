@@ -11,6 +11,9 @@
 #include <drivers/gpio.h>
 #include <logging/log.h>
 
+#include "debounce.h"
+#include "poll_rate.h"
+
 LOG_MODULE_DECLARE(zmk, CONFIG_ZMK_LOG_LEVEL);
 
 #if DT_HAS_COMPAT_STATUS_OKAY(DT_DRV_COMPAT)
@@ -21,25 +24,22 @@ struct kscan_gpio_item_config {
     gpio_flags_t flags;
 };
 
-union work_reference {
-    struct k_delayed_work delayed;
-    struct k_work direct;
-};
-
 struct kscan_gpio_config {
     uint8_t num_of_inputs;
-    uint8_t debounce_period;
+    struct debounce_config debounce_config;
     struct kscan_gpio_item_config inputs[];
 };
 
 struct kscan_gpio_data {
 #if defined(CONFIG_ZMK_KSCAN_DIRECT_POLLING)
-    struct k_timer poll_timer;
+    struct poll_rate poll_rate;
 #endif /* defined(CONFIG_ZMK_KSCAN_DIRECT_POLLING) */
     kscan_callback_t callback;
-    union work_reference work;
+    struct k_delayed_work work;
     const struct device *dev;
-    uint32_t pin_state;
+    struct debounce_row pin_state;
+    uint16_t *debounce_counters;
+    int64_t last_read_at;
     const struct device *inputs[];
 };
 
@@ -53,21 +53,11 @@ static const struct kscan_gpio_item_config *kscan_gpio_input_configs(const struc
     return cfg->inputs;
 }
 
-static void kscan_gpio_direct_queue_read(union work_reference *work, uint8_t debounce_period) {
-    if (debounce_period > 0) {
-        k_delayed_work_cancel(&work->delayed);
-        k_delayed_work_submit(&work->delayed, K_MSEC(debounce_period));
-    } else {
-        k_work_submit(&work->direct);
-    }
-}
-
 #if !defined(CONFIG_ZMK_KSCAN_DIRECT_POLLING)
 
 struct kscan_gpio_irq_callback {
     const struct device *dev;
-    union work_reference *work;
-    uint8_t debounce_period;
+    struct k_delayed_work *work;
     struct gpio_callback callback;
 };
 
@@ -104,25 +94,23 @@ static void kscan_gpio_irq_callback_handler(const struct device *dev, struct gpi
         CONTAINER_OF(cb, struct kscan_gpio_irq_callback, callback);
 
     kscan_gpio_direct_disable(data->dev);
-    kscan_gpio_direct_queue_read(data->work, data->debounce_period);
+    // Debouncing happens while reading, so read right away.
+    k_delayed_work_submit(data->work, K_NO_WAIT);
 }
 
 #else /* !defined(CONFIG_ZMK_KSCAN_DIRECT_POLLING) */
 
-static void kscan_gpio_timer_handler(struct k_timer *timer) {
-    struct kscan_gpio_data *data = CONTAINER_OF(timer, struct kscan_gpio_data, poll_timer);
-
-    kscan_gpio_direct_queue_read(&data->work, 0);
-}
+// Polling interval while no keys were pressed recently, see poll_rate.h.
+#define POLL_INTERVAL_MS 10
 
 static int kscan_gpio_direct_enable(const struct device *dev) {
     struct kscan_gpio_data *data = dev->data;
-    k_timer_start(&data->poll_timer, K_MSEC(10), K_MSEC(10));
+    k_delayed_work_submit(&data->work, K_NO_WAIT);
     return 0;
 }
 static int kscan_gpio_direct_disable(const struct device *dev) {
     struct kscan_gpio_data *data = dev->data;
-    k_timer_stop(&data->poll_timer);
+    k_delayed_work_cancel(&data->work);
     return 0;
 }
 
@@ -140,30 +128,35 @@ static int kscan_gpio_direct_configure(const struct device *dev, kscan_callback_
 static int kscan_gpio_read(const struct device *dev) {
     struct kscan_gpio_data *data = dev->data;
     const struct kscan_gpio_config *cfg = dev->config;
-    uint32_t read_state = data->pin_state;
-    bool submit_follow_up_read = false;
+    uint32_t read_state = 0;
+    uint32_t elapsed_ms = debounce_elapsed_ms(&data->last_read_at);
     for (int i = 0; i < cfg->num_of_inputs; i++) {
         const struct device *in_dev = kscan_gpio_input_devices(dev)[i];
         const struct kscan_gpio_item_config *in_cfg = &kscan_gpio_input_configs(dev)[i];
         WRITE_BIT(read_state, i, gpio_pin_get(in_dev, in_cfg->pin) > 0);
     }
-    for (int i = 0; i < cfg->num_of_inputs; i++) {
-        bool prev_pressed = BIT(i) & data->pin_state;
-        bool pressed = (BIT(i) & read_state) != 0;
-        submit_follow_up_read = (submit_follow_up_read || pressed);
-        if (pressed != prev_pressed) {
-            LOG_DBG("Sending event at %d,%d state %s", 0, i, (pressed ? "on" : "off"));
-            WRITE_BIT(data->pin_state, i, pressed);
-            data->callback(dev, 0, i, pressed);
-        }
+
+    debounce_update_row(&data->pin_state, data->debounce_counters, read_state, elapsed_ms,
+                        &cfg->debounce_config);
+
+    for (uint32_t changed = data->pin_state.changed; changed; changed &= changed - 1) {
+        int i = __builtin_ctz(changed);
+        bool pressed = data->pin_state.pressed & BIT(i);
+        LOG_DBG("Sending event at %d,%d state %s", 0, i, (pressed ? "on" : "off"));
+        data->callback(dev, 0, i, pressed);
     }
 
 #if !defined(CONFIG_ZMK_KSCAN_DIRECT_POLLING)
-    if (submit_follow_up_read) {
-        kscan_gpio_direct_queue_read(&data->work, cfg->debounce_period);
+    // Pressed inputs no longer trigger the level interrupts, and bouncing ones need more reads.
+    if (debounce_row_is_active(&data->pin_state)) {
+        k_delayed_work_submit(&data->work, K_MSEC(cfg->debounce_config.scan_period_ms));
     } else {
         kscan_gpio_direct_enable(dev);
     }
+#else
+    uint32_t next_read_ms = poll_rate_next_ms(
+        &data->poll_rate, debounce_row_is_active(&data->pin_state), POLL_INTERVAL_MS);
+    k_delayed_work_submit(&data->work, K_MSEC(next_read_ms));
 #endif
 
     return 0;
@@ -192,8 +185,10 @@ static const struct kscan_driver_api gpio_driver_api = {
 #define GPIO_INST_INIT(n)                                                                          \
     COND_CODE_0(IS_ENABLED(CONFIG_ZMK_KSCAN_DIRECT_POLLING),                                       \
                 (static struct kscan_gpio_irq_callback irq_callbacks_##n[INST_INPUT_LEN(n)];), ()) \
+    BUILD_ASSERT(INST_INPUT_LEN(n) <= 32, "Direct kscan supports at most 32 inputs");              \
+    static uint16_t debounce_counters_##n[INST_INPUT_LEN(n)];                                      \
     static struct kscan_gpio_data kscan_gpio_data_##n = {                                          \
-        .inputs = {[INST_INPUT_LEN(n) - 1] = NULL}};                                               \
+        .debounce_counters = debounce_counters_##n, .inputs = {[INST_INPUT_LEN(n) - 1] = NULL}};   \
     static int kscan_gpio_init_##n(const struct device *dev) {                                     \
         struct kscan_gpio_data *data = dev->data;                                                  \
         const struct kscan_gpio_config *cfg = dev->config;                                         \
@@ -214,7 +209,6 @@ static const struct kscan_driver_api gpio_driver_api = {
             COND_CODE_0(                                                                           \
                 IS_ENABLED(CONFIG_ZMK_KSCAN_DIRECT_POLLING),                                       \
                 (irq_callbacks_##n[i].work = &data->work; irq_callbacks_##n[i].dev = dev;          \
-                 irq_callbacks_##n[i].debounce_period = cfg->debounce_period;                      \
                  gpio_init_callback(&irq_callbacks_##n[i].callback,                                \
                                     kscan_gpio_irq_callback_handler, BIT(in_cfg->pin));            \
                  err = gpio_add_callback(input_devices[i], &irq_callbacks_##n[i].callback);        \
@@ -225,19 +219,13 @@ static const struct kscan_driver_api gpio_driver_api = {
                 ())                                                                                \
         }                                                                                          \
         data->dev = dev;                                                                           \
-        COND_CODE_1(IS_ENABLED(CONFIG_ZMK_KSCAN_DIRECT_POLLING),                                   \
-                    (k_timer_init(&data->poll_timer, kscan_gpio_timer_handler, NULL);), ())        \
-        if (cfg->debounce_period > 0) {                                                            \
-            k_delayed_work_init(&data->work.delayed, kscan_gpio_work_handler);                     \
-        } else {                                                                                   \
-            k_work_init(&data->work.direct, kscan_gpio_work_handler);                              \
-        }                                                                                          \
+        k_delayed_work_init(&data->work, kscan_gpio_work_handler);                                 \
         return 0;                                                                                  \
     }                                                                                              \
     static const struct kscan_gpio_config kscan_gpio_config_##n = {                                \
         .inputs = {UTIL_LISTIFY(INST_INPUT_LEN(n), KSCAN_DIRECT_INPUT_ITEM, n)},                   \
         .num_of_inputs = INST_INPUT_LEN(n),                                                        \
-        .debounce_period = DT_INST_PROP(n, debounce_period)};                                      \
+        .debounce_config = DEBOUNCE_INST_CONFIG(n)};                                               \
     DEVICE_AND_API_INIT(kscan_gpio_##n, DT_INST_LABEL(n), kscan_gpio_init_##n,                     \
                         &kscan_gpio_data_##n, &kscan_gpio_config_##n, POST_KERNEL,                 \
                         CONFIG_ZMK_KSCAN_INIT_PRIORITY, &gpio_driver_api);
@@ -11,6 +11,9 @@
 #include <drivers/gpio.h>
 #include <logging/log.h>
 
+#include "debounce.h"
+#include "poll_rate.h"
+
 LOG_MODULE_DECLARE(zmk, CONFIG_ZMK_LOG_LEVEL);
 
 #if DT_HAS_COMPAT_STATUS_OKAY(DT_DRV_COMPAT)
@@ -51,11 +54,65 @@ static int kscan_gpio_config_interrupts(const struct device **devices,
 }
 #endif
 
+// Inputs are read a whole GPIO port at a time, once per port for every output, instead of one
+// pin at a time.
+struct kscan_gpio_port {
+    const struct device *dev;
+    gpio_port_value_t value;
+};
+
+// Groups the inputs by their GPIO port, port_indexes maps every input to its port.
+static size_t kscan_gpio_group_ports(const struct device **devices, size_t len,
+                                    struct kscan_gpio_port *ports, uint8_t *port_indexes) {
+    size_t port_len = 0;
+
+    for (int i = 0; i < len; i++) {
+        int p = 0;
+        while (p < port_len && ports[p].dev != devices[i]) {
+            p++;
+        }
+
+        if (p == port_len) {
+            ports[port_len++].dev = devices[i];
+        }
+
+        port_indexes[i] = p;
+    }
+
+    return port_len;
+}
+
+// Reads the ports and packs the active inputs into a bitfield, bit i for input i.
+static int kscan_gpio_read_inputs(struct kscan_gpio_port *ports, size_t port_len,
+                                  const uint8_t *port_indexes,
+                                  const struct kscan_gpio_item_config *configs, size_t len,
+                                  uint32_t *state) {
+    for (int p = 0; p < port_len; p++) {
+        // Applies the active low flags of the inputs, like gpio_pin_get().
+        int err = gpio_port_get(ports[p].dev, &ports[p].value);
+        if (err) {
+            return err;
+        }
+    }
+
+    *state = 0;
+    for (int i = 0; i < len; i++) {
+        if (ports[port_indexes[i]].value & BIT(configs[i].pin)) {
+            *state |= BIT(i);
+        }
+    }
+
+    return 0;
+}
+
 #define COND_POLLING(code) COND_CODE_1(CONFIG_ZMK_KSCAN_MATRIX_POLLING, (code), ())
 #define COND_INTERRUPTS(code) COND_CODE_1(CONFIG_ZMK_KSCAN_MATRIX_POLLING, (), (code))
 #define COND_POLL_OR_INTERRUPTS(pollcode, intcode)                                                 \
     COND_CODE_1(CONFIG_ZMK_KSCAN_MATRIX_POLLING, pollcode, intcode)
 
+// Polling interval while no keys were pressed recently, see poll_rate.h.
+#define POLL_INTERVAL_MS 10
+
 #define INST_MATRIX_ROWS(n) DT_INST_PROP_LEN(n, row_gpios)
 #define INST_MATRIX_COLS(n) DT_INST_PROP_LEN(n, col_gpios)
 #define INST_OUTPUT_LEN(n)                                                                         \
@@ -65,11 +122,15 @@ static int kscan_gpio_config_interrupts(const struct device **devices,
     COND_CODE_0(DT_ENUM_IDX(DT_DRV_INST(n), diode_direction), (INST_MATRIX_COLS(n)),               \
                 (INST_MATRIX_ROWS(n)))
 
+#define INST_MATRIX_ROW(n, input, output)                                                          \
+    COND_CODE_0(DT_ENUM_IDX(DT_DRV_INST(n), diode_direction), (output), (input))
+#define INST_MATRIX_COL(n, input, output)                                                          \
+    COND_CODE_0(DT_ENUM_IDX(DT_DRV_INST(n), diode_direction), (input), (output))
+
 #define GPIO_INST_INIT(n)                                                                          \
     COND_INTERRUPTS(                                                                               \
         struct kscan_gpio_irq_callback_##n {                                                       \
-            struct COND_CODE_0(DT_INST_PROP(n, debounce_period), (k_work), (k_delayed_work)) *     \
-                work;                                                                              \
+            struct k_delayed_work *work;                                                           \
             struct gpio_callback callback;                                                         \
             const struct device *dev;                                                              \
         };                                                                                         \
@@ -77,16 +138,24 @@ static int kscan_gpio_config_interrupts(const struct device **devices,
     struct kscan_gpio_config_##n {                                                                 \
         struct kscan_gpio_item_config rows[INST_MATRIX_ROWS(n)];                                   \
         struct kscan_gpio_item_config cols[INST_MATRIX_COLS(n)];                                   \
+        struct debounce_config debounce_config;                                                    \
     };                                                                                             \
     struct kscan_gpio_data_##n {                                                                   \
         kscan_callback_t callback;                                                                 \
-        COND_POLLING(struct k_timer poll_timer;)                                                   \
-        struct COND_CODE_0(DT_INST_PROP(n, debounce_period), (k_work), (k_delayed_work)) work;     \
-        bool matrix_state[INST_MATRIX_ROWS(n)][INST_MATRIX_COLS(n)];                               \
+        COND_POLLING(struct poll_rate poll_rate;)                                                  \
+        struct k_delayed_work work;                                                                \
+        /* The debounced inputs of every output, bit i for input i. */                             \
+        struct debounce_row matrix_state[INST_OUTPUT_LEN(n)];                                      \
+        uint16_t debounce_counters[INST_OUTPUT_LEN(n)][INST_INPUT_LEN(n)];                         \
+        int64_t last_read_at;                                                                      \
         const struct device *rows[INST_MATRIX_ROWS(n)];                                            \
         const struct device *cols[INST_MATRIX_COLS(n)];                                            \
+        struct kscan_gpio_port input_ports[INST_INPUT_LEN(n)];                                     \
+        size_t input_port_len;                                                                     \
+        uint8_t input_port_indexes[INST_INPUT_LEN(n)];                                             \
         const struct device *dev;                                                                  \
     };                                                                                             \
+    BUILD_ASSERT(INST_INPUT_LEN(n) <= 32, "Matrices with more than 32 inputs are not supported");  \
     static const struct device **kscan_gpio_input_devices_##n(const struct device *dev) {          \
         struct kscan_gpio_data_##n *data = dev->data;                                              \
         return (COND_CODE_0(DT_ENUM_IDX(DT_DRV_INST(n), diode_direction), (data->cols),            \
@@ -129,18 +198,12 @@ static int kscan_gpio_config_interrupts(const struct device **devices,
             }                                                                                      \
         }                                                                                          \
     }                                                                                              \
-    static void kscan_gpio_set_matrix_state_##n(                                                   \
-        bool state[INST_MATRIX_ROWS(n)][INST_MATRIX_COLS(n)], uint32_t input_index,                \
-        uint32_t output_index, bool value) {                                                       \
-        state[COND_CODE_0(DT_ENUM_IDX(DT_DRV_INST(n), diode_direction), (output_index),            \
-                          (input_index))]                                                          \
-             [COND_CODE_0(DT_ENUM_IDX(DT_DRV_INST(n), diode_direction), (input_index),             \
-                          (output_index))] = value;                                                \
-    }                                                                                              \
     static int kscan_gpio_read_##n(const struct device *dev) {                                     \
-        COND_INTERRUPTS(bool submit_follow_up_read = false;)                                       \
+        bool active = false;                                                                       \
         struct kscan_gpio_data_##n *data = dev->data;                                              \
-        static bool read_state[INST_MATRIX_ROWS(n)][INST_MATRIX_COLS(n)];                          \
+        const struct kscan_gpio_config_##n *cfg = dev->config;                                     \
+        static uint32_t read_state[INST_OUTPUT_LEN(n)];                                            \
+        uint32_t elapsed_ms = debounce_elapsed_ms(&data->last_read_at);                            \
         int err;                                                                                   \
         /* Disable our interrupts temporarily while we scan, to avoid       */                     \
         /* re-entry while we iterate columns and set them active one by one */                     \
@@ -154,12 +217,13 @@ static int kscan_gpio_config_interrupts(const struct device **devices,
                 LOG_ERR("Failed to set output active (err %d)", err);                              \
                 return err;                                                                        \
             }                                                                                      \
-            for (int i = 0; i < INST_INPUT_LEN(n); i++) {                                          \
-                const struct device *in_dev = kscan_gpio_input_devices_##n(dev)[i];                \
-                const struct kscan_gpio_item_config *in_cfg =                                      \
-                    &kscan_gpio_input_configs_##n(dev)[i];                                         \
-                kscan_gpio_set_matrix_state_##n(read_state, i, o,                                  \
-                                                gpio_pin_get(in_dev, in_cfg->pin) > 0);            \
+            err = kscan_gpio_read_inputs(data->input_ports, data->input_port_len,                  \
+                                         data->input_port_indexes,                                 \
+                                         kscan_gpio_input_configs_##n(dev), INST_INPUT_LEN(n),     \
+                                         &read_state[o]);                                          \
+            if (err) {                                                                             \
+                LOG_ERR("Failed to read inputs (err %d)", err);                                    \
+                return err;                                                                        \
             }                                                                                      \
             err = gpio_pin_set(out_dev, out_cfg->pin, 0);                                          \
             if (err) {                                                                             \
@@ -169,27 +233,31 @@ static int kscan_gpio_config_interrupts(const struct device **devices,
         }                                                                                          \
         /* Set all our outputs as active again. */                                                 \
         COND_INTERRUPTS(kscan_gpio_set_output_state_##n(dev, 1);)                                  \
-        for (int r = 0; r < INST_MATRIX_ROWS(n); r++) {                                            \
-            for (int c = 0; c < INST_MATRIX_COLS(n); c++) {                                        \
-                bool pressed = read_state[r][c];                                                   \
-                /* Follow up reads needed because further interrupts won't fire on already tripped \
-                 * input GPIO pins */                                                              \
-                COND_INTERRUPTS(submit_follow_up_read = (submit_follow_up_read || pressed);)       \
-                if (pressed != data->matrix_state[r][c]) {                                         \
-                    LOG_DBG("Sending event at %d,%d state %s", r, c, (pressed ? "on" : "off"));    \
-                    data->matrix_state[r][c] = pressed;                                            \
-                    data->callback(dev, r, c, pressed);                                            \
-                }                                                                                  \
+        for (int o = 0; o < INST_OUTPUT_LEN(n); o++) {                                             \
+            struct debounce_row *row = &data->matrix_state[o];                                     \
+            debounce_update_row(row, data->debounce_counters[o], read_state[o], elapsed_ms,        \
+                                &cfg->debounce_config);                                            \
+            active = active || debounce_row_is_active(row);                                        \
+            uint32_t changed = row->changed;                                                       \
+            while (changed) {                                                                      \
+                int i = __builtin_ctz(changed);                                                    \
+                changed &= changed - 1;                                                            \
+                bool pressed = row->pressed & BIT(i);                                              \
+                uint32_t r = INST_MATRIX_ROW(n, i, o);                                             \
+                uint32_t c = INST_MATRIX_COL(n, i, o);                                             \
+                LOG_DBG("Sending event at %d,%d state %s", r, c, (pressed ? "on" : "off"));        \
+                data->callback(dev, r, c, pressed);                                                \
             }                                                                                      \
         }                                                                                          \
-        COND_INTERRUPTS(                                                                           \
-            if (submit_follow_up_read) {                                                           \
-                COND_CODE_0(DT_INST_PROP(n, debounce_period), ({ k_work_submit(&data->work); }),   \
-                            ({                                                                     \
-                                k_delayed_work_cancel(&data->work);                                \
-                                k_delayed_work_submit(&data->work, K_MSEC(5));                     \
-                            }))                                                                    \
-            } else { kscan_gpio_enable_interrupts_##n(dev); })                                     \
+        /* With interrupts, follow up reads are needed because further interrupts won't fire on    \
+         * already tripped input GPIO pins, and to finish debouncing */                            \
+        COND_POLL_OR_INTERRUPTS(                                                                   \
+            (uint32_t next_read_ms =                                                               \
+                 poll_rate_next_ms(&data->poll_rate, active, POLL_INTERVAL_MS);                    \
+             k_delayed_work_submit(&data->work, K_MSEC(next_read_ms));),                           \
+            (if (active) {                                                                         \
+                k_delayed_work_submit(&data->work, K_MSEC(cfg->debounce_config.scan_period_ms));   \
+            } else { kscan_gpio_enable_interrupts_##n(dev); }))                                    \
         return 0;                                                                                  \
     }                                                                                              \
     static void kscan_gpio_work_handler_##n(struct k_work *work) {                                 \
@@ -201,11 +269,8 @@ static int kscan_gpio_config_interrupts(const struct device **devices,
         struct kscan_gpio_irq_callback_##n *data =                                                 \
             CONTAINER_OF(cb, struct kscan_gpio_irq_callback_##n, callback);                        \
         kscan_gpio_disable_interrupts_##n(data->dev);                                              \
-        COND_CODE_0(DT_INST_PROP(n, debounce_period), ({ k_work_submit(data->work); }), ({         \
-                        k_delayed_work_cancel(data->work);                                         \
-                        k_delayed_work_submit(data->work,                                          \
-                                              K_MSEC(DT_INST_PROP(n, debounce_period)));           \
-                    }))                                                                            \
+        /* Debouncing happens while reading, so read right away. */                                \
+        k_delayed_work_submit(data->work, K_NO_WAIT);                                              \
     })                                                                                             \
                                                                                                    \
     static struct kscan_gpio_data_##n kscan_gpio_data_##n = {                                      \
@@ -221,21 +286,15 @@ static int kscan_gpio_config_interrupts(const struct device **devices,
     };                                                                                             \
     static int kscan_gpio_enable_##n(const struct device *dev) {                                   \
         COND_POLL_OR_INTERRUPTS((struct kscan_gpio_data_##n *data = dev->data;                     \
-                                 k_timer_start(&data->poll_timer, K_MSEC(10), K_MSEC(10));         \
-                                 return 0;),                                                       \
+                                 k_delayed_work_submit(&data->work, K_NO_WAIT); return 0;),        \
                                 (int err = kscan_gpio_enable_interrupts_##n(dev);                  \
                                  if (err) { return err; } return kscan_gpio_read_##n(dev);))       \
     };                                                                                             \
     static int kscan_gpio_disable_##n(const struct device *dev) {                                  \
         COND_POLL_OR_INTERRUPTS((struct kscan_gpio_data_##n *data = dev->data;                     \
-                                 k_timer_stop(&data->poll_timer); return 0;),                      \
+                                 k_delayed_work_cancel(&data->work); return 0;),                   \
                                 (return kscan_gpio_disable_interrupts_##n(dev);))                  \
     };                                                                                             \
-    COND_POLLING(static void kscan_gpio_timer_handler_##n(struct k_timer *timer) {                 \
-        struct kscan_gpio_data_##n *data =                                                         \
-            CONTAINER_OF(timer, struct kscan_gpio_data_##n, poll_timer);                           \
-        k_work_submit(&data->work.work);                                                           \
-    })                                                                                             \
     static int kscan_gpio_init_##n(const struct device *dev) {                                     \
         struct kscan_gpio_data_##n *data = dev->data;                                              \
         int err;                                                                                   \
@@ -264,6 +323,9 @@ static int kscan_gpio_config_interrupts(const struct device **devices,
                     return err;                                                                    \
                 })                                                                                 \
         }                                                                                          \
+        data->input_port_len =                                                                     \
+            kscan_gpio_group_ports(input_devices, INST_INPUT_LEN(n), data->input_ports,            \
+                                   data->input_port_indexes);                                      \
         const struct device **output_devices = kscan_gpio_output_devices_##n(dev);                 \
         for (int o = 0; o < INST_OUTPUT_LEN(n); o++) {                                             \
             const struct kscan_gpio_item_config *out_cfg = &kscan_gpio_output_configs_##n(dev)[o]; \
@@ -281,12 +343,9 @@ static int kscan_gpio_config_interrupts(const struct device **devices,
             }                                                                                      \
         }                                                                                          \
         data->dev = dev;                                                                           \
-        (COND_CODE_0(DT_INST_PROP(n, debounce_period), (k_work_init), (k_delayed_work_init)))(     \
-            &data->work, kscan_gpio_work_handler_##n);                                             \
-        COND_POLL_OR_INTERRUPTS(                                                                   \
-            (k_timer_init(&data->poll_timer, kscan_gpio_timer_handler_##n, NULL);                  \
-             kscan_gpio_set_output_state_##n(dev, 0);),                                            \
-            (kscan_gpio_set_output_state_##n(dev, 1);))                                            \
+        k_delayed_work_init(&data->work, kscan_gpio_work_handler_##n);                             \
+        COND_POLL_OR_INTERRUPTS((kscan_gpio_set_output_state_##n(dev, 0);),                        \
+                                (kscan_gpio_set_output_state_##n(dev, 1);))                        \
         return 0;                                                                                  \
     }                                                                                              \
     static const struct kscan_driver_api gpio_driver_api_##n = {                                   \
@@ -297,6 +356,7 @@ static int kscan_gpio_config_interrupts(const struct device **devices,
     static const struct kscan_gpio_config_##n kscan_gpio_config_##n = {                            \
         .rows = {UTIL_LISTIFY(INST_MATRIX_ROWS(n), _KSCAN_GPIO_ROW_CFG_INIT, n)},                  \
         .cols = {UTIL_LISTIFY(INST_MATRIX_COLS(n), _KSCAN_GPIO_COL_CFG_INIT, n)},                  \
+        .debounce_config = DEBOUNCE_INST_CONFIG(n),                                                \
     };                                                                                             \
     DEVICE_AND_API_INIT(kscan_gpio_##n, DT_INST_LABEL(n), kscan_gpio_init_##n,                     \
                         &kscan_gpio_data_##n, &kscan_gpio_config_##n, APPLICATION,                 \
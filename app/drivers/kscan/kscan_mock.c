@@ -14,6 +14,7 @@
 LOG_MODULE_DECLARE(zmk, CONFIG_ZMK_LOG_LEVEL);
 
 #include <dt-bindings/zmk/kscan_mock.h>
+#include <zmk/event_trace.h>
 
 struct kscan_mock_data {
     kscan_callback_t callback;
@@ -57,6 +58,9 @@ static int kscan_mock_configure(const struct device *dev, kscan_callback_t callb
             k_delayed_work_submit(&data->work, K_MSEC(ZMK_MOCK_MSEC(ev)));                         \
         } else if (cfg->exit_after) {                                                              \
             LOG_DBG("Exiting");                                                                    \
+            /* The histograms are logged last, flush them before exiting. */                       \
+            COND_CODE_1(CONFIG_ZMK_EVENT_MANAGER_TRACING, (zmk_event_trace_dump(); LOG_PANIC();),  \
+                        ())                                                                        \
             exit(0);                                                                               \
         }                                                                                          \
     }                                                                                              \
@@ -0,0 +1,30 @@
+/*
+ * Copyright (c) 2020 The ZMK Contributors
+ *
+ * SPDX-License-Identifier: MIT
+ */
+
+#include <kernel.h>
+
+#include <zmk/activity.h>
+
+#include "poll_rate.h"
+
+uint32_t poll_rate_next_ms(struct poll_rate *rate, bool active, uint32_t interval_ms) {
+    int64_t now = k_uptime_get();
+
+    if (active) {
+        rate->last_active_at = now;
+        return CONFIG_ZMK_KSCAN_POLLING_ACTIVE_INTERVAL;
+    }
+
+    if (now - rate->last_active_at < CONFIG_ZMK_KSCAN_POLLING_ACTIVE_TIMEOUT) {
+        return CONFIG_ZMK_KSCAN_POLLING_ACTIVE_INTERVAL;
+    }
+
+    if (zmk_activity_get_state() != ZMK_ACTIVITY_ACTIVE) {
+        return MAX(interval_ms, CONFIG_ZMK_KSCAN_POLLING_IDLE_INTERVAL);
+    }
+
+    return interval_ms;
+}
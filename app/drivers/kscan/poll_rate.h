@@ -0,0 +1,23 @@
+/*
+ * Copyright (c) 2020 The ZMK Contributors
+ *
+ * SPDX-License-Identifier: MIT
+ */
+
+#pragma once
+
+#include <zephyr/types.h>
+#include <stdbool.h>
+
+// Polling drivers read every CONFIG_ZMK_KSCAN_POLLING_ACTIVE_INTERVAL while keys are pressed,
+// bouncing or were released within CONFIG_ZMK_KSCAN_POLLING_ACTIVE_TIMEOUT, at their own interval
+// while the keyboard is active, and at CONFIG_ZMK_KSCAN_POLLING_IDLE_INTERVAL once it went idle.
+// Unlike the debounce scan period of the interrupt driven reads, the active interval also
+// decides how soon the next key press is seen.
+struct poll_rate {
+    int64_t last_active_at;
+};
+
+// Returns the time until the next read. active tells whether keys of the last read were pressed
+// or bouncing, interval_ms is the normal polling interval of the driver.
+uint32_t poll_rate_next_ms(struct poll_rate *rate, bool active, uint32_t interval_ms);
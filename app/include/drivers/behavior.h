@@ -36,6 +36,20 @@ __subsystem struct behavior_driver_api {
  * @endcond
  */
 
+/**
+ * @brief Get the behavior device of a binding, resolving and caching it on first use
+ * @param binding Pointer to the binding
+ *
+ * @retval Pointer to the behavior device, or NULL if no device matches the binding's label.
+ */
+static inline const struct device *
+zmk_behavior_binding_device(struct zmk_behavior_binding *binding) {
+    if (binding->device == NULL && binding->behavior_dev != NULL) {
+        binding->device = device_get_binding(binding->behavior_dev);
+    }
+    return binding->device;
+}
+
 /**
  * @brief Handle the keymap binding which needs to be converted from relative "toggle" to absolute
  * "turn on"
@@ -50,7 +64,11 @@ __syscall int behavior_keymap_binding_convert_central_state_dependent_params(
 
 static inline int z_impl_behavior_keymap_binding_convert_central_state_dependent_params(
     struct zmk_behavior_binding *binding, struct zmk_behavior_binding_event event) {
-    const struct device *dev = device_get_binding(binding->behavior_dev);
+    const struct device *dev = zmk_behavior_binding_device(binding);
+    if (dev == NULL) {
+        return -ENODEV;
+    }
+
     const struct behavior_driver_api *api = (const struct behavior_driver_api *)dev->api;
 
     if (api->binding_convert_central_state_dependent_params == NULL) {
@@ -74,7 +92,11 @@ __syscall int behavior_keymap_binding_pressed(struct zmk_behavior_binding *bindi
 
 static inline int z_impl_behavior_keymap_binding_pressed(struct zmk_behavior_binding *binding,
                                                          struct zmk_behavior_binding_event event) {
-    const struct device *dev = device_get_binding(binding->behavior_dev);
+    const struct device *dev = zmk_behavior_binding_device(binding);
+    if (dev == NULL) {
+        return -ENODEV;
+    }
+
     const struct behavior_driver_api *api = (const struct behavior_driver_api *)dev->api;
 
     if (api->binding_pressed == NULL) {
@@ -97,7 +119,11 @@ __syscall int behavior_keymap_binding_released(struct zmk_behavior_binding *bind
 
 static inline int z_impl_behavior_keymap_binding_released(struct zmk_behavior_binding *binding,
                                                           struct zmk_behavior_binding_event event) {
-    const struct device *dev = device_get_binding(binding->behavior_dev);
+    const struct device *dev = zmk_behavior_binding_device(binding);
+    if (dev == NULL) {
+        return -ENODEV;
+    }
+
     const struct behavior_driver_api *api = (const struct behavior_driver_api *)dev->api;
 
     if (api->binding_released == NULL) {
@@ -124,7 +150,11 @@ __syscall int behavior_sensor_keymap_binding_triggered(struct zmk_behavior_bindi
 static inline int
 z_impl_behavior_sensor_keymap_binding_triggered(struct zmk_behavior_binding *binding,
                                                 const struct device *sensor, int64_t timestamp) {
-    const struct device *dev = device_get_binding(binding->behavior_dev);
+    const struct device *dev = zmk_behavior_binding_device(binding);
+    if (dev == NULL) {
+        return -ENODEV;
+    }
+
     const struct behavior_driver_api *api = (const struct behavior_driver_api *)dev->api;
 
     if (api->sensor_binding_triggered == NULL) {
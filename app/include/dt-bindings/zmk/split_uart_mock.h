@@ -0,0 +1,12 @@
+/*
+ * Copyright (c) 2020 The ZMK Contributors
+ *
+ * SPDX-License-Identifier: MIT
+ */
+
+#pragma once
+
+// The next len bytes of rx-bytes, received msec after the previous chunk was due.
+#define ZMK_SPLIT_UART_MOCK_CHUNK(len, msec) (len + (msec << 16))
+#define ZMK_SPLIT_UART_MOCK_LEN(v) (v & 0xFFFF)
+#define ZMK_SPLIT_UART_MOCK_MSEC(v) (v >> 16)
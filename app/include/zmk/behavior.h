@@ -9,8 +9,12 @@
 #define ZMK_BEHAVIOR_OPAQUE 0
 #define ZMK_BEHAVIOR_TRANSPARENT 1
 
+struct device;
+
 struct zmk_behavior_binding {
     char *behavior_dev;
+    // Resolved from behavior_dev on first use, see zmk_behavior_binding_device()
+    const struct device *device;
     uint32_t param1;
     uint32_t param2;
 };
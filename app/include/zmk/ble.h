@@ -24,5 +24,7 @@ int zmk_ble_unpair_all();
 bool zmk_ble_handle_key_user(struct zmk_key_event *key_event);
 
 #if IS_ENABLED(CONFIG_ZMK_SPLIT_BLE_ROLE_CENTRAL)
-void zmk_ble_set_peripheral_addr(bt_addr_le_t *addr);
+// Returns the slot of a known split peripheral, storing new ones in the first open slot.
+// Returns -ENOMEM if all slots belong to other peripherals.
+int zmk_ble_put_peripheral_addr(const bt_addr_le_t *addr);
 #endif /* IS_ENABLED(CONFIG_ZMK_SPLIT_BLE_ROLE_CENTRAL) */
\ No newline at end of file
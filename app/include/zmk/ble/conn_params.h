@@ -0,0 +1,27 @@
+/*
+ * Copyright (c) 2020 The ZMK Contributors
+ *
+ * SPDX-License-Identifier: MIT
+ */
+
+#pragma once
+
+#include <bluetooth/conn.h>
+
+// Connection parameters as negotiated with the central, in Bluetooth units: the interval in
+// 1.25ms steps and the supervision timeout in 10ms steps.
+struct zmk_ble_conn_params {
+    uint16_t interval;
+    uint16_t latency;
+    uint16_t timeout;
+};
+
+// Connections this device is the peripheral of ask for short intervals while the keyboard is
+// active and for longer ones with peripheral latency once it goes idle.
+void zmk_ble_conn_params_connected(struct bt_conn *conn);
+void zmk_ble_conn_params_disconnected(struct bt_conn *conn);
+void zmk_ble_conn_params_updated(struct bt_conn *conn, uint16_t interval, uint16_t latency,
+                                 uint16_t timeout);
+
+// Returns -ENOTCONN if no parameters were negotiated for the connection yet.
+int zmk_ble_conn_params_get(struct bt_conn *conn, struct zmk_ble_conn_params *params);
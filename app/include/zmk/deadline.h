@@ -0,0 +1,42 @@
+/*
+ * Copyright (c) 2020 The ZMK Contributors
+ *
+ * SPDX-License-Identifier: MIT
+ */
+
+#pragma once
+
+#include <kernel.h>
+#include <sys/dlist.h>
+
+// Deadlines share a single delayed work item on the system work queue, which only needs to be
+// resubmitted when the earliest deadline changes. Expired deadlines fire in order of their
+// expiry time, deadlines with the same expiry time fire in the order they were scheduled.
+//
+// Deadlines are not locked, they should only be used from the system work queue that ZMK
+// processes its events on. Handlers run on that queue too, so a deadline that is cancelled
+// there never fires afterwards.
+
+struct zmk_deadline;
+
+typedef void (*zmk_deadline_handler_t)(struct zmk_deadline *deadline);
+
+struct zmk_deadline {
+    sys_dnode_t node;
+    // Uptime in milliseconds at which the handler should be called.
+    int64_t expires_at;
+    zmk_deadline_handler_t handler;
+};
+
+void zmk_deadline_init(struct zmk_deadline *deadline, zmk_deadline_handler_t handler);
+
+// Schedules the deadline, or moves it if it is already scheduled. Expiry times in the past fire
+// as soon as the system work queue gets to it.
+void zmk_deadline_schedule(struct zmk_deadline *deadline, int64_t expires_at);
+
+// Returns true if the deadline was scheduled and will not fire anymore.
+bool zmk_deadline_cancel(struct zmk_deadline *deadline);
+
+static inline bool zmk_deadline_is_scheduled(struct zmk_deadline *deadline) {
+    return sys_dnode_is_linked(&deadline->node);
+}
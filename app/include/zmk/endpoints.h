@@ -18,4 +18,10 @@ int zmk_endpoints_select(enum zmk_endpoint endpoint);
 int zmk_endpoints_toggle();
 enum zmk_endpoint zmk_endpoints_selected();
 
+// Reports that did not change since they were last sent are skipped. With
+// CONFIG_ZMK_ENDPOINTS_COALESCE_REPORTS the report is queued and sent once the current work
+// queue item is done, together with any other changes made by it.
 int zmk_endpoints_send_report(uint16_t usage_page);
+
+// Sends the queued reports right away.
+int zmk_endpoints_flush_reports();
@@ -10,13 +10,22 @@
 #include <kernel.h>
 #include <zephyr/types.h>
 
+struct zmk_event_subscription;
+
+// Subscriptions are grouped per event type by the linker (see zmk-events.ld), so each
+// event type knows the contiguous range of subscriptions that need to see its events.
 struct zmk_event_type {
     const char *name;
+    const struct zmk_event_subscription *subscriptions_start;
+    const struct zmk_event_subscription *subscriptions_end;
 };
 
 typedef struct {
     const struct zmk_event_type *event;
     uint8_t last_listener_index;
+#if IS_ENABLED(CONFIG_ZMK_EVENT_MANAGER_TRACING)
+    uint32_t captured_at;
+#endif
 } zmk_event_t;
 
 #define ZMK_EV_EVENT_BUBBLE 0
@@ -26,6 +35,10 @@ typedef struct {
 typedef int (*zmk_listener_callback_t)(const zmk_event_t *eh);
 struct zmk_listener {
     zmk_listener_callback_t callback;
+#if IS_ENABLED(CONFIG_ZMK_EVENT_MANAGER_TRACING)
+    const char *name;
+    struct zmk_event_trace_histogram *histogram;
+#endif
 };
 
 struct zmk_event_subscription {
@@ -33,6 +46,9 @@ struct zmk_event_subscription {
     const struct zmk_listener *listener;
 };
 
+#define ZMK_EVENT_SUBSCRIPTION_SECTION(event_type, part)                                           \
+    __attribute__((__section__(".event_subscription." STRINGIFY(event_type) "." #part)))
+
 #define ZMK_EVENT_DECLARE(event_type)                                                              \
     struct event_type##_event {                                                                    \
         zmk_event_t header;                                                                        \
@@ -43,13 +59,24 @@ struct zmk_event_subscription {
     extern const struct zmk_event_type zmk_event_##event_type;
 
 #define ZMK_EVENT_IMPL(event_type)                                                                 \
-    const struct zmk_event_type zmk_event_##event_type = {.name = STRINGIFY(event_type)};          \
+    static const Z_DECL_ALIGN(struct zmk_event_subscription)                                       \
+        zmk_event_subs_start_##event_type[0] __used ZMK_EVENT_SUBSCRIPTION_SECTION(event_type, 0); \
+    static const Z_DECL_ALIGN(struct zmk_event_subscription)                                       \
+        zmk_event_subs_end_##event_type[0] __used ZMK_EVENT_SUBSCRIPTION_SECTION(event_type, 2);   \
+    const struct zmk_event_type zmk_event_##event_type = {                                         \
+        .name = STRINGIFY(event_type),                                                             \
+        .subscriptions_start = zmk_event_subs_start_##event_type,                                  \
+        .subscriptions_end = zmk_event_subs_end_##event_type,                                      \
+    };                                                                                             \
     const struct zmk_event_type *zmk_event_ref_##event_type __used                                 \
         __attribute__((__section__(".event_type"))) = &zmk_event_##event_type;                     \
     struct event_type##_event *new_##event_type(struct event_type data) {                          \
-        struct event_type##_event *ev =                                                            \
-            (struct event_type##_event *)k_malloc(sizeof(struct event_type##_event));              \
-        ev->header.event = &zmk_event_##event_type;                                                \
+        struct event_type##_event *ev = (struct event_type##_event *)zmk_event_manager_alloc(      \
+            sizeof(struct event_type##_event));                                                    \
+        if (ev == NULL) {                                                                          \
+            return NULL;                                                                           \
+        }                                                                                          \
+        ev->header = (zmk_event_t){.event = &zmk_event_##event_type};                              \
         ev->data = data;                                                                           \
         return ev;                                                                                 \
     };                                                                                             \
@@ -58,12 +85,19 @@ struct zmk_event_subscription {
                                                       : NULL;                                      \
     };
 
+#if IS_ENABLED(CONFIG_ZMK_EVENT_MANAGER_TRACING)
+#define ZMK_LISTENER(mod, cb)                                                                      \
+    static struct zmk_event_trace_histogram zmk_listener_histogram_##mod;                          \
+    const struct zmk_listener zmk_listener_##mod = {                                               \
+        .callback = cb, .name = STRINGIFY(mod), .histogram = &zmk_listener_histogram_##mod};
+#else
 #define ZMK_LISTENER(mod, cb) const struct zmk_listener zmk_listener_##mod = {.callback = cb};
+#endif
 
 #define ZMK_SUBSCRIPTION(mod, ev_type)                                                             \
     const Z_DECL_ALIGN(struct zmk_event_subscription)                                              \
         _CONCAT(_CONCAT(zmk_event_sub_, mod), ev_type) __used                                      \
-        __attribute__((__section__(".event_subscription"))) = {                                    \
+        ZMK_EVENT_SUBSCRIPTION_SECTION(ev_type, 1) = {                                             \
             .event_type = &zmk_event_##ev_type,                                                    \
             .listener = &zmk_listener_##mod,                                                       \
     };
@@ -78,9 +112,28 @@ struct zmk_event_subscription {
 
 #define ZMK_EVENT_RELEASE(ev) zmk_event_manager_release((zmk_event_t *)ev);
 
-#define ZMK_EVENT_FREE(ev) k_free((void *)ev);
+#define ZMK_EVENT_FREE(ev) zmk_event_manager_free((void *)ev);
+
+struct zmk_event_manager_alloc_stats {
+    // Events allocated from the small and large slabs
+    uint32_t small_slab_allocs;
+    uint32_t large_slab_allocs;
+    // Allocations that found their slab exhausted
+    uint32_t small_slab_exhausted;
+    uint32_t large_slab_exhausted;
+    // Allocations that were served by the system heap
+    uint32_t heap_allocs;
+    // Allocations that failed completely, dropping the event
+    uint32_t failed_allocs;
+};
+
+void *zmk_event_manager_alloc(size_t size);
+void zmk_event_manager_free(void *event);
+void zmk_event_manager_get_alloc_stats(struct zmk_event_manager_alloc_stats *stats);
 
 int zmk_event_manager_raise(zmk_event_t *event);
 int zmk_event_manager_raise_after(zmk_event_t *event, const struct zmk_listener *listener);
 int zmk_event_manager_raise_at(zmk_event_t *event, const struct zmk_listener *listener);
-int zmk_event_manager_release(zmk_event_t *event);
\ No newline at end of file
+int zmk_event_manager_release(zmk_event_t *event);
+
+#include <zmk/event_trace.h>
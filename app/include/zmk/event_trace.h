@@ -0,0 +1,74 @@
+/*
+ * Copyright (c) 2020 The ZMK Contributors
+ *
+ * SPDX-License-Identifier: MIT
+ */
+
+#pragma once
+
+#include <kernel.h>
+#include <zmk/event_manager.h>
+
+// Bucket 0 counts durations below 1us, bucket n counts durations in [2^(n-1), 2^n) us and
+// the last bucket also collects everything that is longer.
+#define ZMK_EVENT_TRACE_HISTOGRAM_BUCKETS 16
+
+struct zmk_event_trace_histogram {
+    uint32_t buckets[ZMK_EVENT_TRACE_HISTOGRAM_BUCKETS];
+    uint32_t count;
+    uint32_t max_us;
+    uint64_t total_us;
+};
+
+#if IS_ENABLED(CONFIG_ZMK_EVENT_MANAGER_TRACING)
+
+void zmk_event_trace_histogram_record(struct zmk_event_trace_histogram *histogram, uint32_t us);
+
+static inline uint32_t zmk_event_trace_now() { return k_cycle_get_32(); }
+
+// Listener durations include the time spent in any events raised from within the listener.
+void zmk_event_trace_listener(const struct zmk_listener *listener, uint32_t start_cycles);
+void zmk_event_trace_captured(zmk_event_t *event);
+void zmk_event_trace_resumed(zmk_event_t *event);
+
+// End to end latency is measured from the oldest key scan that did not result in a report
+// yet, to the next report sent to the endpoints.
+void zmk_event_trace_scan();
+void zmk_event_trace_report();
+// An unchanged report is not sent, so the scans before it count as handled without a report.
+void zmk_event_trace_report_skipped();
+
+// Transports that know when the host actually picked a report up pass the scan timestamp of the
+// report they are sending to zmk_event_trace_delivered(), to measure scan to host latency.
+// The timestamp is 0 for reports that did not complete a scan.
+uint32_t zmk_event_trace_report_scan();
+void zmk_event_trace_delivered(uint32_t scan_at);
+
+// Records how long a report waited in a transport queue, queued_at is from zmk_event_trace_now().
+void zmk_event_trace_backlog(uint32_t queued_at);
+
+const struct zmk_event_trace_histogram *
+zmk_event_trace_listener_histogram(const struct zmk_listener *listener);
+const struct zmk_event_trace_histogram *zmk_event_trace_capture_histogram();
+const struct zmk_event_trace_histogram *zmk_event_trace_report_histogram();
+const struct zmk_event_trace_histogram *zmk_event_trace_delivery_histogram();
+const struct zmk_event_trace_histogram *zmk_event_trace_backlog_histogram();
+
+void zmk_event_trace_reset();
+void zmk_event_trace_dump();
+
+#else
+
+static inline uint32_t zmk_event_trace_now() { return 0; }
+static inline void zmk_event_trace_listener(const struct zmk_listener *listener,
+                                            uint32_t start_cycles) {}
+static inline void zmk_event_trace_captured(zmk_event_t *event) {}
+static inline void zmk_event_trace_resumed(zmk_event_t *event) {}
+static inline void zmk_event_trace_scan() {}
+static inline void zmk_event_trace_report() {}
+static inline void zmk_event_trace_report_skipped() {}
+static inline uint32_t zmk_event_trace_report_scan() { return 0; }
+static inline void zmk_event_trace_delivered(uint32_t scan_at) {}
+static inline void zmk_event_trace_backlog(uint32_t queued_at) {}
+
+#endif /* IS_ENABLED(CONFIG_ZMK_EVENT_MANAGER_TRACING) */
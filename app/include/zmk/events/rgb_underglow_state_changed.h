@@ -0,0 +1,17 @@
+/*
+ * Copyright (c) 2020 The ZMK Contributors
+ *
+ * SPDX-License-Identifier: MIT
+ */
+
+#pragma once
+
+#include <zephyr.h>
+#include <zmk/event_manager.h>
+#include <zmk/rgb_underglow.h>
+
+struct zmk_rgb_underglow_state_changed {
+    struct zmk_rgb_underglow_state state;
+};
+
+ZMK_EVENT_DECLARE(zmk_rgb_underglow_state_changed);
\ No newline at end of file
@@ -15,7 +15,9 @@
 
 #define COLLECTION_REPORT 0x03
 
-#define ZMK_HID_KEYBOARD_NKRO_SIZE 6
+#define ZMK_HID_KEYBOARD_NKRO_MAX_USAGE 0xFF
+
+#define ZMK_HID_BOOT_KEYBOARD_SIZE 6
 
 #define ZMK_HID_CONSUMER_NKRO_SIZE 6
 
@@ -74,6 +76,30 @@ static const uint8_t zmk_hid_report_desc[] = {
     /* USAGE_PAGE (Keyboard/Keypad) */
     HID_GI_USAGE_PAGE,
     HID_USAGE_KEY,
+#if IS_ENABLED(CONFIG_ZMK_HID_REPORT_TYPE_NKRO)
+    /* LOGICAL_MINIMUM (0) */
+    HID_GI_LOGICAL_MIN(1),
+    0x00,
+    /* LOGICAL_MAXIMUM (1) */
+    HID_GI_LOGICAL_MAX(1),
+    0x01,
+    /* USAGE_MINIMUM (Reserved) */
+    HID_LI_USAGE_MIN(1),
+    0x00,
+    /* USAGE_MAXIMUM (ZMK_HID_KEYBOARD_NKRO_MAX_USAGE) */
+    HID_LI_USAGE_MAX(1),
+    ZMK_HID_KEYBOARD_NKRO_MAX_USAGE,
+    /* REPORT_SIZE (1) */
+    HID_GI_REPORT_SIZE,
+    0x01,
+    /* REPORT_COUNT (ZMK_HID_KEYBOARD_NKRO_MAX_USAGE + 1) */
+    HID_ITEM(HID_ITEM_TAG_REPORT_COUNT, HID_ITEM_TYPE_GLOBAL, 2),
+    (ZMK_HID_KEYBOARD_NKRO_MAX_USAGE + 1) & 0xFF,
+    (ZMK_HID_KEYBOARD_NKRO_MAX_USAGE + 1) >> 8,
+    /* INPUT (Data,Var,Abs) */
+    HID_MI_INPUT,
+    0x02,
+#else
     /* LOGICAL_MINIMUM (0) */
     HID_GI_LOGICAL_MIN(1),
     0x00,
@@ -89,12 +115,13 @@ static const uint8_t zmk_hid_report_desc[] = {
     /* REPORT_SIZE (1) */
     HID_GI_REPORT_SIZE,
     0x08,
-    /* REPORT_COUNT (ZMK_HID_KEYBOARD_NKRO_SIZE) */
+    /* REPORT_COUNT (CONFIG_ZMK_HID_KEYBOARD_REPORT_SIZE) */
     HID_GI_REPORT_COUNT,
-    ZMK_HID_KEYBOARD_NKRO_SIZE,
+    CONFIG_ZMK_HID_KEYBOARD_REPORT_SIZE,
     /* INPUT (Data,Ary,Abs) */
     HID_MI_INPUT,
     0x00,
+#endif
 
     /* END_COLLECTION */
     HID_MI_COLLECTION_END,
@@ -139,17 +166,22 @@ static const uint8_t zmk_hid_report_desc[] = {
     HID_MI_COLLECTION_END,
 };
 
-// struct zmk_hid_boot_report
-// {
-//     uint8_t modifiers;
-//     uint8_t _unused;
-//     uint8_t keys[6];
-// } __packed;
+// Sent without a report ID to hosts that switched to the boot protocol.
+struct zmk_hid_boot_report {
+    zmk_mod_flags_t modifiers;
+    uint8_t _reserved;
+    uint8_t keys[ZMK_HID_BOOT_KEYBOARD_SIZE];
+} __packed;
 
 struct zmk_hid_keyboard_report_body {
     zmk_mod_flags_t modifiers;
     uint8_t _reserved;
-    uint8_t keys[ZMK_HID_KEYBOARD_NKRO_SIZE];
+#if IS_ENABLED(CONFIG_ZMK_HID_REPORT_TYPE_NKRO)
+    // One bit per usage, usage N is bit N % 8 of keys[N / 8].
+    uint8_t keys[(ZMK_HID_KEYBOARD_NKRO_MAX_USAGE + 1) / 8];
+#else
+    uint8_t keys[CONFIG_ZMK_HID_KEYBOARD_REPORT_SIZE];
+#endif
 } __packed;
 
 struct zmk_hid_keyboard_report {
@@ -183,3 +215,4 @@ void zmk_hid_consumer_clear();
 
 struct zmk_hid_keyboard_report *zmk_hid_get_keyboard_report();
 struct zmk_hid_consumer_report *zmk_hid_get_consumer_report();
+struct zmk_hid_boot_report *zmk_hid_get_boot_report();
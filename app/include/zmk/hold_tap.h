@@ -0,0 +1,19 @@
+/*
+ * Copyright (c) 2020 The ZMK Contributors
+ *
+ * SPDX-License-Identifier: MIT
+ */
+
+#pragma once
+
+#include <zephyr/types.h>
+
+// Statistics to size CONFIG_ZMK_BHV_HOLD_TAP_MAX_CAPTURED_EVENTS with.
+struct zmk_hold_tap_capture_stats {
+    // Most events captured at the same time
+    uint32_t max_captured;
+    // Events that did not fit, each one decided the undecided hold-tap early
+    uint32_t overflows;
+};
+
+void zmk_hold_tap_get_capture_stats(struct zmk_hold_tap_capture_stats *stats);
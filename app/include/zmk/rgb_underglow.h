@@ -12,6 +12,14 @@ struct zmk_led_hsb {
     uint8_t b;
 };
 
+struct zmk_rgb_underglow_state {
+    struct zmk_led_hsb color;
+    uint8_t animation_speed;
+    uint8_t current_effect;
+    uint16_t animation_step;
+    bool on;
+};
+
 int zmk_rgb_underglow_toggle();
 int zmk_rgb_underglow_get_state(bool *state);
 int zmk_rgb_underglow_on();
@@ -24,4 +32,6 @@ int zmk_rgb_underglow_change_hue(int direction);
 int zmk_rgb_underglow_change_sat(int direction);
 int zmk_rgb_underglow_change_brt(int direction);
 int zmk_rgb_underglow_change_spd(int direction);
-int zmk_rgb_underglow_set_hsb(struct zmk_led_hsb color);
\ No newline at end of file
+int zmk_rgb_underglow_set_hsb(struct zmk_led_hsb color);
+int zmk_rgb_underglow_get_full_state(struct zmk_rgb_underglow_state *state);
+int zmk_rgb_underglow_set_full_state(const struct zmk_rgb_underglow_state *state);
\ No newline at end of file
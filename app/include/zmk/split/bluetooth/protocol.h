@@ -0,0 +1,44 @@
+/*
+ * Copyright (c) 2020 The ZMK Contributors
+ *
+ * SPDX-License-Identifier: MIT
+ */
+
+#pragma once
+
+#include <zephyr/types.h>
+#include <sys/util.h>
+
+#include <zmk/matrix.h>
+
+#define ZMK_SPLIT_BT_POSITION_STATE_LEN ceiling_fraction(ZMK_KEYMAP_LEN, 8)
+
+// Position events carry a 7 bit sequence number and the new state in the top bit.
+#define ZMK_SPLIT_BT_EVENT_SEQUENCE_MASK 0x7F
+#define ZMK_SPLIT_BT_EVENT_PRESSED BIT(7)
+
+// Position of a record that only carries the sequence number of the last position event sent,
+// so the central notices events that were dropped before it without waiting for the next one.
+#define ZMK_SPLIT_BT_POSITION_SEQUENCE_HINT 0xFFFF
+
+// Fits in a notification with the default ATT MTU of 23 bytes.
+#define ZMK_SPLIT_BT_POSITION_EVENTS_PER_NOTIFY 4
+
+struct zmk_split_bt_position_event {
+    // Position on the peripheral, the central adds the peripheral's position offset.
+    uint16_t position;
+    uint8_t sequence_state;
+    // Peripheral uptime in ms when the change was scanned, truncated to 16 bits. The central
+    // maps it into its own uptime, see zmk_split_clock_map().
+    uint16_t timestamp;
+} __packed;
+
+// Read by the central to resync after it missed position events. sequence is the sequence
+// number of the last position event the state includes. The central reads as many position
+// bytes as the peripheral has, which may take several reads for large keymaps. The peripheral
+// serves all reads that continue a read from offset 0 from the state it had at that first read.
+struct zmk_split_bt_position_state {
+    uint8_t sequence;
+    uint16_t position_offset;
+    uint8_t positions[ZMK_SPLIT_BT_POSITION_STATE_LEN];
+} __packed;
@@ -0,0 +1,20 @@
+/*
+ * Copyright (c) 2020 The ZMK Contributors
+ *
+ * SPDX-License-Identifier: MIT
+ */
+
+#pragma once
+
+#include <zephyr/types.h>
+#include <stdbool.h>
+
+#include <zmk/split/central_state.h>
+
+// Called by the split transports for position changes on a peripheral. The events are raised
+// from the system work queue in the order they were reported.
+void zmk_split_central_position_state_changed(uint32_t position, bool pressed, int64_t timestamp);
+
+// Implemented by the split transport the central is built with. Sends the state to every
+// connected peripheral, and to peripherals that connect later.
+int zmk_split_central_send_state(const struct zmk_split_central_state *state);
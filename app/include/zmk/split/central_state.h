@@ -0,0 +1,30 @@
+/*
+ * Copyright (c) 2020 The ZMK Contributors
+ *
+ * SPDX-License-Identifier: MIT
+ */
+
+#pragma once
+
+#include <zephyr/types.h>
+#include <sys/util.h>
+
+// The underglow fields are valid, the central has an underglow.
+#define ZMK_SPLIT_CENTRAL_STATE_UNDERGLOW BIT(0)
+#define ZMK_SPLIT_CENTRAL_STATE_UNDERGLOW_ON BIT(1)
+
+// State of the central mirrored on the peripherals, the same on every transport. Fields are
+// little endian. Newer centrals may append fields, peripherals ignore what they do not know.
+struct zmk_split_central_state {
+    // Active layers including the default layer.
+    uint64_t layers;
+    // enum zmk_activity_state
+    uint8_t activity;
+    uint8_t flags;
+    uint16_t underglow_hue;
+    uint8_t underglow_saturation;
+    uint8_t underglow_brightness;
+    uint8_t underglow_effect;
+    uint8_t underglow_speed;
+    uint16_t underglow_animation_step;
+} __packed;
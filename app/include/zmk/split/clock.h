@@ -0,0 +1,25 @@
+/*
+ * Copyright (c) 2020 The ZMK Contributors
+ *
+ * SPDX-License-Identifier: MIT
+ */
+
+#pragma once
+
+#include <zephyr/types.h>
+#include <stdbool.h>
+
+// Estimates the offset between the uptime of a peripheral and the central, so the 16 bit ms
+// timestamps on peripheral position events can be mapped into central uptime.
+struct zmk_split_clock {
+    bool synced;
+    int64_t window_start;
+    uint16_t window_min_offset;
+    uint16_t previous_window_min_offset;
+};
+
+// Forgets the offset, e.g. when the peripheral disconnected and may have rebooted.
+void zmk_split_clock_reset(struct zmk_split_clock *clock);
+
+int64_t zmk_split_clock_map(struct zmk_split_clock *clock, uint16_t timestamp,
+                            int64_t received_at);
@@ -0,0 +1,20 @@
+/*
+ * Copyright (c) 2020 The ZMK Contributors
+ *
+ * SPDX-License-Identifier: MIT
+ */
+
+#pragma once
+
+#include <zephyr/types.h>
+
+// Implemented by the split transport the peripheral is built with.
+int zmk_split_peripheral_position_pressed(uint32_t position, int64_t timestamp);
+int zmk_split_peripheral_position_released(uint32_t position, int64_t timestamp);
+
+// Called by the split transport with the state the central sent, len is the length it sent.
+// May be called from any thread, the changes are raised as events on the system work queue.
+void zmk_split_peripheral_central_state_received(const void *state, size_t len);
+
+// Called by the split transport when the connection to the central was lost.
+void zmk_split_peripheral_central_state_lost();
@@ -0,0 +1,21 @@
+/*
+ * Copyright (c) 2020 The ZMK Contributors
+ *
+ * SPDX-License-Identifier: MIT
+ */
+
+#pragma once
+
+#include <zephyr/types.h>
+
+#include <zmk/split/uart/protocol.h>
+
+// Called from the system work queue for every frame that arrived with a valid CRC.
+typedef void (*zmk_split_uart_frame_handler_t)(const struct zmk_split_uart_frame_header *header,
+                                               const uint8_t *payload, size_t len);
+
+int zmk_split_uart_link_init(zmk_split_uart_frame_handler_t handler);
+
+// Queues a frame for sending. Frames are not retransmitted by the link, a frame lost or
+// corrupted on the wire is simply not handed to the other side.
+int zmk_split_uart_link_send(uint8_t type, uint8_t sequence, const void *payload, size_t len);
@@ -0,0 +1,81 @@
+/*
+ * Copyright (c) 2020 The ZMK Contributors
+ *
+ * SPDX-License-Identifier: MIT
+ */
+
+#pragma once
+
+#include <zephyr/types.h>
+#include <sys/util.h>
+
+#include <zmk/matrix.h>
+#include <zmk/split/central_state.h>
+
+// Frames are delimited by flag bytes. Flag and escape bytes inside a frame are sent as the escape
+// byte followed by the original byte XOR 0x20. Every frame ends with a CRC-16/CCITT of the header
+// and payload, little endian.
+#define ZMK_SPLIT_UART_FRAME_FLAG 0x7E
+#define ZMK_SPLIT_UART_FRAME_ESCAPE 0x7D
+#define ZMK_SPLIT_UART_FRAME_ESCAPE_XOR 0x20
+
+enum zmk_split_uart_frame_type {
+    // Peripheral to central, sequenced.
+    ZMK_SPLIT_UART_FRAME_POSITION_EVENTS,
+    ZMK_SPLIT_UART_FRAME_POSITION_STATE,
+    // Peripheral to central after it booted, repeated until the central asks for a resync.
+    ZMK_SPLIT_UART_FRAME_RESET,
+    // Central to peripheral, the sequence number of the next frame the central expects.
+    // Peripheral to central, the sequence number of the central state frame it received.
+    ZMK_SPLIT_UART_FRAME_ACK,
+    // Central to peripheral, asks for a position state frame.
+    ZMK_SPLIT_UART_FRAME_RESYNC,
+    // Central to peripheral, a struct zmk_split_central_state. Sent again until it is acked,
+    // only the latest one matters.
+    ZMK_SPLIT_UART_FRAME_CENTRAL_STATE,
+    // Peripheral to central after ZMK_SPLIT_UART_KEEPALIVE_MS without sending anything else.
+    ZMK_SPLIT_UART_FRAME_KEEPALIVE,
+};
+
+// The central releases the keys of the peripheral when it received no frame for this long, e.g.
+// because the cable was pulled. A few keepalives may get lost before that happens.
+#define ZMK_SPLIT_UART_LINK_TIMEOUT_MS                                                             \
+    (CONFIG_ZMK_SPLIT_UART_LINK_TIMEOUT_RETRANSMITS * CONFIG_ZMK_SPLIT_UART_RETRANSMIT_MS)
+#define ZMK_SPLIT_UART_KEEPALIVE_MS (ZMK_SPLIT_UART_LINK_TIMEOUT_MS / 4)
+
+struct zmk_split_uart_frame_header {
+    uint8_t type;
+    uint8_t sequence;
+} __packed;
+
+struct zmk_split_uart_position_event {
+    // Position on the peripheral, the central adds the peripheral's position offset.
+    uint16_t position;
+    uint8_t pressed;
+    // Peripheral uptime in ms when the change was scanned, truncated to 16 bits.
+    uint16_t timestamp;
+} __packed;
+
+#define ZMK_SPLIT_UART_POSITION_EVENTS_PER_FRAME 8
+
+#define ZMK_SPLIT_UART_POSITION_STATE_LEN ceiling_fraction(ZMK_KEYMAP_LEN, 8)
+
+struct zmk_split_uart_position_state {
+    uint16_t position_offset;
+    uint8_t positions[ZMK_SPLIT_UART_POSITION_STATE_LEN];
+} __packed;
+
+#define ZMK_SPLIT_UART_MAX_PAYLOAD_LEN                                                             \
+    MAX(MAX(sizeof(struct zmk_split_uart_position_state),                                          \
+            ZMK_SPLIT_UART_POSITION_EVENTS_PER_FRAME *                                             \
+                sizeof(struct zmk_split_uart_position_event)),                                     \
+        sizeof(struct zmk_split_central_state))
+
+#define ZMK_SPLIT_UART_CRC_LEN sizeof(uint16_t)
+
+#define ZMK_SPLIT_UART_MAX_FRAME_LEN                                                               \
+    (sizeof(struct zmk_split_uart_frame_header) + ZMK_SPLIT_UART_MAX_PAYLOAD_LEN +                 \
+     ZMK_SPLIT_UART_CRC_LEN)
+
+// Every byte may need escaping, plus the opening and closing flags.
+#define ZMK_SPLIT_UART_MAX_ENCODED_FRAME_LEN (2 * ZMK_SPLIT_UART_MAX_FRAME_LEN + 2)
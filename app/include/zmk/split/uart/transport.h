@@ -0,0 +1,19 @@
+/*
+ * Copyright (c) 2020 The ZMK Contributors
+ *
+ * SPDX-License-Identifier: MIT
+ */
+
+#pragma once
+
+#include <zephyr/types.h>
+
+// The byte stream the link sends its frames over, the split UART or a mock in tests.
+
+// Called with every chunk of received bytes, possibly from an ISR.
+typedef void (*zmk_split_uart_transport_receive_t)(const uint8_t *data, size_t len);
+
+int zmk_split_uart_transport_init(zmk_split_uart_transport_receive_t receive);
+
+// Queues the bytes for sending, either all of them or none with -ENOMEM if they do not fit.
+int zmk_split_uart_transport_send(const uint8_t *data, size_t len);
@@ -26,4 +26,7 @@ static inline bool zmk_usb_is_hid_ready() { return zmk_usb_get_conn_state() == Z
 
 #ifdef CONFIG_ZMK_USB
 int zmk_usb_hid_send_report(const uint8_t *report, size_t len);
+#if IS_ENABLED(CONFIG_ZMK_USB_BOOT)
+uint8_t zmk_usb_hid_get_protocol();
+#endif /* IS_ENABLED(CONFIG_ZMK_USB_BOOT) */
 #endif /* CONFIG_ZMK_USB */
\ No newline at end of file
@@ -44,6 +44,18 @@ int set_state(enum zmk_activity_state state) {
 
 enum zmk_activity_state zmk_activity_get_state() { return activity_state; }
 
+// Sleeping is the weakest state, it never keeps the peripheral from idling on its own.
+static enum zmk_activity_state central_activity_state = ZMK_ACTIVITY_SLEEP;
+
+void zmk_activity_set_central_state(enum zmk_activity_state state) {
+    central_activity_state = state;
+
+    if (state == ZMK_ACTIVITY_ACTIVE) {
+        activity_last_uptime = k_uptime_get();
+        set_state(ZMK_ACTIVITY_ACTIVE);
+    }
+}
+
 int activity_event_listener(const zmk_event_t *eh) {
     activity_last_uptime = k_uptime_get();
 
@@ -52,6 +64,9 @@ int activity_event_listener(const zmk_event_t *eh) {
 
 void activity_work_handler(struct k_work *work) {
     int32_t current = k_uptime_get();
+    if (central_activity_state == ZMK_ACTIVITY_ACTIVE) {
+        activity_last_uptime = current;
+    }
     int32_t inactive_time = current - activity_last_uptime;
 #if IS_ENABLED(CONFIG_ZMK_SLEEP)
     if (inactive_time > MAX_SLEEP_MS) {
@@ -13,6 +13,8 @@
 #include <logging/log.h>
 #include <zmk/behavior.h>
 #include <zmk/matrix.h>
+#include <zmk/deadline.h>
+#include <zmk/hold_tap.h>
 #include <zmk/endpoints.h>
 #include <zmk/event_manager.h>
 #include <zmk/events/position_state_changed.h>
@@ -25,7 +27,7 @@ LOG_MODULE_DECLARE(zmk, CONFIG_ZMK_LOG_LEVEL);
 #if DT_HAS_COMPAT_STATUS_OKAY(DT_DRV_COMPAT)
 
 #define ZMK_BHV_HOLD_TAP_MAX_HELD 10
-#define ZMK_BHV_HOLD_TAP_MAX_CAPTURED_EVENTS 40
+#define ZMK_BHV_HOLD_TAP_MAX_CAPTURED_EVENTS CONFIG_ZMK_BHV_HOLD_TAP_MAX_CAPTURED_EVENTS
 
 // increase if you have keyboard with more keys.
 #define ZMK_BHV_HOLD_TAP_POSITION_NOT_USED 9999
@@ -53,8 +55,9 @@ enum decision_moment {
 
 struct behavior_hold_tap_config {
     int tapping_term_ms;
-    char *hold_behavior_dev;
-    char *tap_behavior_dev;
+    // Only the behavior of these bindings is used, the parameters come from the keymap.
+    struct zmk_behavior_binding hold_behavior;
+    struct zmk_behavior_binding tap_behavior;
     int quick_tap_ms;
     enum flavor flavor;
     bool retro_tap;
@@ -66,21 +69,41 @@ struct active_hold_tap {
     uint32_t param_hold;
     uint32_t param_tap;
     int64_t timestamp;
+    int64_t release_timestamp;
     enum status status;
     const struct behavior_hold_tap_config *config;
-    struct k_delayed_work work;
-    bool work_is_cancelled;
+    struct zmk_deadline timer;
+};
+
+// A captured event, or the press or release of a hold-tap that has to wait for the
+// undecided_hold_tap to be decided first.
+struct captured_event {
+    const zmk_event_t *event;
+    struct active_hold_tap *hold_tap;
+    bool pressed;
 };
 
 // The undecided hold tap is the hold tap that needs to be decided before
 // other keypress events can be released. While the undecided_hold_tap is
 // not NULL, most events are captured in captured_events.
+// Hold-taps that are pressed while another one is undecided are queued in
+// captured_events too, so they are decided one after the other in the order
+// they were pressed.
 // After the hold_tap is decided, it will stay in the active_hold_taps until
-// its key-up has been processed and the delayed work is cleaned up.
+// its key-up has been processed.
 struct active_hold_tap *undecided_hold_tap = NULL;
 struct active_hold_tap active_hold_taps[ZMK_BHV_HOLD_TAP_MAX_HELD] = {};
 // We capture most position_state_changed events and some modifiers_state_changed events.
-const zmk_event_t *captured_events[ZMK_BHV_HOLD_TAP_MAX_CAPTURED_EVENTS] = {};
+// They are kept in a ring buffer, oldest first. The first captured_events_releasing events are
+// being released by release_captured_events(), the ones after them are captured by the
+// undecided_hold_tap.
+struct captured_event captured_events[ZMK_BHV_HOLD_TAP_MAX_CAPTURED_EVENTS] = {};
+int captured_events_head = 0;
+int captured_events_len = 0;
+int captured_events_releasing = 0;
+// Number of key down events captured by the undecided_hold_tap, for each key position.
+uint8_t captured_keydowns[ZMK_KEYMAP_LEN] = {};
+static struct zmk_hold_tap_capture_stats capture_stats;
 
 // Keep track of which key was tapped most recently for 'quick_tap_ms'
 struct last_tapped {
@@ -100,90 +123,143 @@ static bool is_quick_tap(struct active_hold_tap *hold_tap) {
            last_tapped.tap_deadline > hold_tap->timestamp;
 }
 
-static int capture_event(const zmk_event_t *event) {
-    for (int i = 0; i < ZMK_BHV_HOLD_TAP_MAX_CAPTURED_EVENTS; i++) {
-        if (captured_events[i] == NULL) {
-            captured_events[i] = event;
-            return 0;
-        }
+static void push_captured_event(struct captured_event captured) {
+    int tail = (captured_events_head + captured_events_len) % ZMK_BHV_HOLD_TAP_MAX_CAPTURED_EVENTS;
+    captured_events[tail] = captured;
+    captured_events_len++;
+}
+
+static struct captured_event pop_captured_event() {
+    struct captured_event captured = captured_events[captured_events_head];
+    captured_events[captured_events_head] = (struct captured_event){0};
+    captured_events_head = (captured_events_head + 1) % ZMK_BHV_HOLD_TAP_MAX_CAPTURED_EVENTS;
+    captured_events_len--;
+    return captured;
+}
+
+static int capture(struct captured_event captured) {
+    if (captured_events_len == ZMK_BHV_HOLD_TAP_MAX_CAPTURED_EVENTS) {
+        capture_stats.overflows++;
+        LOG_WRN("Hold-tap capture queue is full (%d overflows so far), increase "
+                "CONFIG_ZMK_BHV_HOLD_TAP_MAX_CAPTURED_EVENTS",
+                capture_stats.overflows);
+        return -ENOMEM;
     }
-    return -ENOMEM;
+
+    push_captured_event(captured);
+    if (captured_events_len > capture_stats.max_captured) {
+        capture_stats.max_captured = captured_events_len;
+        LOG_DBG("Hold-tap capture queue reached %d events", capture_stats.max_captured);
+    }
+    return 0;
 }
 
-static struct zmk_position_state_changed *find_captured_keydown_event(uint32_t position) {
-    struct zmk_position_state_changed *last_match = NULL;
-    for (int i = 0; i < ZMK_BHV_HOLD_TAP_MAX_CAPTURED_EVENTS; i++) {
-        const zmk_event_t *eh = captured_events[i];
-        if (eh == NULL) {
-            return last_match;
-        }
-        struct zmk_position_state_changed *position_event = as_zmk_position_state_changed(eh);
-        if (position_event == NULL) {
-            continue;
-        }
+void zmk_hold_tap_get_capture_stats(struct zmk_hold_tap_capture_stats *stats) {
+    *stats = capture_stats;
+}
 
-        if (position_event->position == position && position_event->state) {
-            last_match = position_event;
-        }
+static int capture_event(const zmk_event_t *event) {
+    int ret = capture((struct captured_event){.event = event});
+    if (ret < 0) {
+        return ret;
+    }
+
+    const struct zmk_position_state_changed *position_event = as_zmk_position_state_changed(event);
+    if (position_event != NULL && position_event->state &&
+        position_event->position < ZMK_KEYMAP_LEN) {
+        captured_keydowns[position_event->position]++;
     }
-    return last_match;
+    return 0;
+}
+
+static bool has_captured_keydown_event(uint32_t position) {
+    return position < ZMK_KEYMAP_LEN && captured_keydowns[position] > 0;
 }
 
 const struct zmk_listener zmk_listener_behavior_hold_tap;
 
+static bool run_or_queue_hold_tap(struct active_hold_tap *hold_tap, bool pressed);
+static void decide_hold_tap(struct active_hold_tap *hold_tap, enum decision_moment decision_moment);
+
+static void release_next_captured_event() {
+    struct captured_event captured = pop_captured_event();
+    captured_events_releasing--;
+    if (captured.event == NULL) {
+        LOG_DBG("Releasing queued hold-tap %s for position %d",
+                (captured.pressed ? "press" : "release"), captured.hold_tap->position);
+        run_or_queue_hold_tap(captured.hold_tap, captured.pressed);
+        return;
+    }
+
+    const zmk_event_t *captured_event = captured.event;
+    if (undecided_hold_tap != NULL) {
+        k_msleep(10);
+    }
+
+    struct zmk_position_state_changed *position_event;
+    struct zmk_keycode_state_changed *modifier_event;
+    if ((position_event = as_zmk_position_state_changed(captured_event)) != NULL) {
+        LOG_DBG("Releasing key position event for position %d %s", position_event->position,
+                (position_event->state ? "pressed" : "released"));
+    } else if ((modifier_event = as_zmk_keycode_state_changed(captured_event)) != NULL) {
+        LOG_DBG("Releasing mods changed event 0x%02X %s", modifier_event->keycode,
+                (modifier_event->state ? "pressed" : "released"));
+    }
+    ZMK_EVENT_RAISE_AT(captured_event, behavior_hold_tap);
+}
+
 static void release_captured_events() {
     if (undecided_hold_tap != NULL) {
         return;
     }
 
-    // We use a trick to prevent copying the captured_events array.
-    //
-    // Events for different mod-tap instances are separated by a NULL pointer.
-    //
-    // The first event popped will never be catched by the next active hold-tap
-    // because to start capturing a mod-tap-key-down event must first completely
-    // go through the events queue.
-    //
-    // Example of this release process;
-    // [mt2_down, k1_down, k1_up, mt2_up, null, ...]
-    //  ^
-    // mt2_down position event isn't captured because no hold-tap is active.
-    // mt2_down behavior event is handled, now we have an undecided hold-tap
-    // [null, k1_down, k1_up, mt2_up, null, ...]
-    //        ^
-    // k1_down  is captured by the mt2 mod-tap
-    // !note that searches for find_captured_keydown_event by the mt2 behavior will stop at the
-    // first null encountered [mt1_down, null, k1_up, mt2_up, null, ...]
-    //                  ^
-    // k1_up event is captured by the new hold-tap:
-    // [k1_down, k1_up, null, mt2_up, null, ...]
-    //                        ^
-    // mt2_up event is not captured but causes release of mt2 behavior
-    // [k1_down, k1_up, null, null, null, ...]
-    // now mt2 will start releasing it's own captured positions.
-    for (int i = 0; i < ZMK_BHV_HOLD_TAP_MAX_CAPTURED_EVENTS; i++) {
-        const zmk_event_t *captured_event = captured_events[i];
-        if (captured_event == NULL) {
-            return;
-        }
-        captured_events[i] = NULL;
-        if (undecided_hold_tap != NULL) {
-            k_msleep(10);
+    // All events captured by the hold-tap that was just decided are released, oldest first.
+    // While they are released a new hold-tap may become undecided and capture them again, those
+    // are appended after the events that still have to be released.
+    int captured = captured_events_len - captured_events_releasing;
+    memset(captured_keydowns, 0, sizeof(captured_keydowns));
+
+    if (captured_events_releasing > 0) {
+        // One of the events released by an outer call decided a new hold-tap. The events that
+        // hold-tap captured are older than the ones still to be released by the outer call,
+        // so move those behind them. The outer call then releases all of them in order.
+        if (captured > 0) {
+            for (int i = 0; i < captured_events_releasing; i++) {
+                push_captured_event(pop_captured_event());
+            }
+            captured_events_releasing += captured;
         }
+        return;
+    }
+
+    captured_events_releasing = captured;
+    while (captured_events_releasing > 0) {
+        release_next_captured_event();
+    }
+}
 
-        struct zmk_position_state_changed *position_event;
-        struct zmk_keycode_state_changed *modifier_event;
-        if ((position_event = as_zmk_position_state_changed(captured_event)) != NULL) {
-            LOG_DBG("Releasing key position event for position %d %s", position_event->position,
-                    (position_event->state ? "pressed" : "released"));
-        } else if ((modifier_event = as_zmk_keycode_state_changed(captured_event)) != NULL) {
-            LOG_DBG("Releasing mods changed event 0x%02X %s", modifier_event->keycode,
-                    (modifier_event->state ? "pressed" : "released"));
+// Called when the ring is full while release_captured_events() is still releasing events from
+// it. Those events are older than the one that did not fit, so the oldest of them are released
+// right away until there is room behind them. Events captured by a hold-tap that becomes
+// undecided in the meantime are settled as if its tapping term ran out.
+static void make_room_behind_released_events() {
+    while (captured_events_len == ZMK_BHV_HOLD_TAP_MAX_CAPTURED_EVENTS ||
+           captured_events_len > captured_events_releasing) {
+        if (captured_events_len > captured_events_releasing) {
+            decide_hold_tap(undecided_hold_tap, HT_TIMER_EVENT);
+        } else {
+            release_next_captured_event();
         }
-        ZMK_EVENT_RAISE_AT(captured_event, behavior_hold_tap);
     }
 }
 
+// Appends an event or hold-tap press to the events being released, after all of them.
+static void release_after_released_events(struct captured_event captured) {
+    make_room_behind_released_events();
+    push_captured_event(captured);
+    captured_events_releasing++;
+}
+
 static struct active_hold_tap *find_hold_tap(uint32_t position) {
     for (int i = 0; i < ZMK_BHV_HOLD_TAP_MAX_HELD; i++) {
         if (active_hold_taps[i].position == position) {
@@ -214,7 +290,6 @@ static struct active_hold_tap *store_hold_tap(uint32_t position, uint32_t param_
 static void clear_hold_tap(struct active_hold_tap *hold_tap) {
     hold_tap->position = ZMK_BHV_HOLD_TAP_POSITION_NOT_USED;
     hold_tap->status = STATUS_UNDECIDED;
-    hold_tap->work_is_cancelled = false;
 }
 
 static void decide_balanced(struct active_hold_tap *hold_tap, enum decision_moment event) {
@@ -316,6 +391,19 @@ static inline const char *decision_moment_str(enum decision_moment decision_mome
     }
 }
 
+static struct zmk_behavior_binding get_binding(struct active_hold_tap *hold_tap) {
+    struct zmk_behavior_binding binding;
+    if (hold_tap->status == STATUS_HOLD_TIMER || hold_tap->status == STATUS_HOLD_INTERRUPT) {
+        binding = hold_tap->config->hold_behavior;
+        binding.param1 = hold_tap->param_hold;
+    } else {
+        binding = hold_tap->config->tap_behavior;
+        binding.param1 = hold_tap->param_tap;
+    }
+    binding.param2 = 0;
+    return binding;
+}
+
 static int press_binding(struct active_hold_tap *hold_tap) {
     if (hold_tap->config->retro_tap && hold_tap->status == STATUS_HOLD_TIMER) {
         return 0;
@@ -326,13 +414,8 @@ static int press_binding(struct active_hold_tap *hold_tap) {
         .timestamp = hold_tap->timestamp,
     };
 
-    struct zmk_behavior_binding binding = {0};
-    if (hold_tap->status == STATUS_HOLD_TIMER || hold_tap->status == STATUS_HOLD_INTERRUPT) {
-        binding.behavior_dev = hold_tap->config->hold_behavior_dev;
-        binding.param1 = hold_tap->param_hold;
-    } else {
-        binding.behavior_dev = hold_tap->config->tap_behavior_dev;
-        binding.param1 = hold_tap->param_tap;
+    struct zmk_behavior_binding binding = get_binding(hold_tap);
+    if (hold_tap->status == STATUS_TAP) {
         store_last_tapped(hold_tap);
     }
     return behavior_keymap_binding_pressed(&binding, event);
@@ -348,14 +431,7 @@ static int release_binding(struct active_hold_tap *hold_tap) {
         .timestamp = hold_tap->timestamp,
     };
 
-    struct zmk_behavior_binding binding = {0};
-    if (hold_tap->status == STATUS_HOLD_TIMER || hold_tap->status == STATUS_HOLD_INTERRUPT) {
-        binding.behavior_dev = hold_tap->config->hold_behavior_dev;
-        binding.param1 = hold_tap->param_hold;
-    } else {
-        binding.behavior_dev = hold_tap->config->tap_behavior_dev;
-        binding.param1 = hold_tap->param_tap;
-    }
+    struct zmk_behavior_binding binding = get_binding(hold_tap);
     return behavior_keymap_binding_released(&binding, event);
 }
 
@@ -404,6 +480,74 @@ static void decide_retro_tap(struct active_hold_tap *hold_tap) {
     }
 }
 
+static void press_hold_tap(struct active_hold_tap *hold_tap) {
+    undecided_hold_tap = hold_tap;
+
+    if (is_quick_tap(hold_tap)) {
+        decide_hold_tap(hold_tap, HT_QUICK_TAP);
+    }
+
+    // if this behavior was queued we have to adjust the timer to only
+    // wait for the remaining time.
+    int64_t tapping_term_end = hold_tap->timestamp + hold_tap->config->tapping_term_ms;
+    if (tapping_term_end > k_uptime_get()) {
+        zmk_deadline_schedule(&hold_tap->timer, tapping_term_end);
+    } else {
+        decide_hold_tap(hold_tap, HT_TIMER_EVENT);
+    }
+}
+
+static void release_hold_tap(struct active_hold_tap *hold_tap) {
+    // If these events were queued, the timer event may be queued too late or not at all.
+    // We insert a timer event before the TH_KEY_UP event to verify.
+    zmk_deadline_cancel(&hold_tap->timer);
+    if (hold_tap->release_timestamp > (hold_tap->timestamp + hold_tap->config->tapping_term_ms)) {
+        decide_hold_tap(hold_tap, HT_TIMER_EVENT);
+    }
+
+    decide_hold_tap(hold_tap, HT_KEY_UP);
+    decide_retro_tap(hold_tap);
+    release_binding(hold_tap);
+    clear_hold_tap(hold_tap);
+}
+
+// A hold-tap that is pressed while another one is undecided waits in captured_events until all
+// hold-taps pressed before it are decided. Its release then waits behind its press.
+static bool hold_tap_must_wait(struct active_hold_tap *hold_tap, bool pressed) {
+    if (undecided_hold_tap == NULL || undecided_hold_tap == hold_tap) {
+        return false;
+    }
+    return pressed || hold_tap->status == STATUS_UNDECIDED;
+}
+
+// Returns false if the press or release was queued.
+static bool run_or_queue_hold_tap(struct active_hold_tap *hold_tap, bool pressed) {
+    while (hold_tap_must_wait(hold_tap, pressed)) {
+        struct captured_event captured = {.hold_tap = hold_tap, .pressed = pressed};
+        if (capture(captured) == 0) {
+            LOG_DBG("%d queued hold-tap %s behind undecided hold-tap %d", hold_tap->position,
+                    (pressed ? "press" : "release"), undecided_hold_tap->position);
+            return false;
+        }
+        if (captured_events_releasing > 0) {
+            // Older events are still being released, the press or release has to wait for them.
+            release_after_released_events(captured);
+            LOG_DBG("%d queued hold-tap %s behind released events", hold_tap->position,
+                    (pressed ? "press" : "release"));
+            return false;
+        }
+        // The queue is full, settle the undecided hold-tap as if its tapping term ran out.
+        decide_hold_tap(undecided_hold_tap, HT_TIMER_EVENT);
+    }
+
+    if (pressed) {
+        press_hold_tap(hold_tap);
+    } else {
+        release_hold_tap(hold_tap);
+    }
+    return true;
+}
+
 static void update_hold_status_for_retro_tap(uint32_t ignore_position) {
     for (int i = 0; i < ZMK_BHV_HOLD_TAP_MAX_HELD; i++) {
         struct active_hold_tap *hold_tap = &active_hold_taps[i];
@@ -422,14 +566,13 @@ static void update_hold_status_for_retro_tap(uint32_t ignore_position) {
 
 static int on_hold_tap_binding_pressed(struct zmk_behavior_binding *binding,
                                        struct zmk_behavior_binding_event event) {
-    const struct device *dev = device_get_binding(binding->behavior_dev);
+    const struct device *dev = zmk_behavior_binding_device(binding);
     const struct behavior_hold_tap_config *cfg = dev->config;
 
-    if (undecided_hold_tap != NULL) {
-        LOG_DBG("ERROR another hold-tap behavior is undecided.");
-        // if this happens, make sure the behavior events occur AFTER other position events.
-        return ZMK_BEHAVIOR_OPAQUE;
-    }
+    // Resolve the hold and tap behaviors once, so later presses reuse the cached devices.
+    // Like mod-morph, the bindings in the config are updated in place for this.
+    zmk_behavior_binding_device((struct zmk_behavior_binding *)&cfg->hold_behavior);
+    zmk_behavior_binding_device((struct zmk_behavior_binding *)&cfg->tap_behavior);
 
     struct active_hold_tap *hold_tap =
         store_hold_tap(event.position, binding->param1, binding->param2, event.timestamp, cfg);
@@ -440,21 +583,7 @@ static int on_hold_tap_binding_pressed(struct zmk_behavior_binding *binding,
     }
 
     LOG_DBG("%d new undecided hold_tap", event.position);
-    undecided_hold_tap = hold_tap;
-
-    if (is_quick_tap(hold_tap)) {
-        decide_hold_tap(hold_tap, HT_QUICK_TAP);
-    }
-
-    // if this behavior was queued we have to adjust the timer to only
-    // wait for the remaining time.
-    int32_t tapping_term_ms_left = (hold_tap->timestamp + cfg->tapping_term_ms) - k_uptime_get();
-    if (tapping_term_ms_left > 0) {
-        k_delayed_work_submit(&hold_tap->work, K_MSEC(tapping_term_ms_left));
-    } else {
-        decide_hold_tap(hold_tap, HT_TIMER_EVENT);
-    }
-
+    run_or_queue_hold_tap(hold_tap, true);
     return ZMK_BEHAVIOR_OPAQUE;
 }
 
@@ -466,27 +595,10 @@ static int on_hold_tap_binding_released(struct zmk_behavior_binding *binding,
         return ZMK_BEHAVIOR_OPAQUE;
     }
 
-    // If these events were queued, the timer event may be queued too late or not at all.
-    // We insert a timer event before the TH_KEY_UP event to verify.
-    int work_cancel_result = k_delayed_work_cancel(&hold_tap->work);
-    if (event.timestamp > (hold_tap->timestamp + hold_tap->config->tapping_term_ms)) {
-        decide_hold_tap(hold_tap, HT_TIMER_EVENT);
-    }
-
-    decide_hold_tap(hold_tap, HT_KEY_UP);
-    decide_retro_tap(hold_tap);
-    release_binding(hold_tap);
-
-    if (work_cancel_result == -EINPROGRESS) {
-        // let the timer handler clean up
-        // if we'd clear now, the timer may call back for an uninitialized active_hold_tap.
-        LOG_DBG("%d hold-tap timer work in event queue", event.position);
-        hold_tap->work_is_cancelled = true;
-    } else {
+    hold_tap->release_timestamp = event.timestamp;
+    if (run_or_queue_hold_tap(hold_tap, false)) {
         LOG_DBG("%d cleaning up hold-tap", event.position);
-        clear_hold_tap(hold_tap);
     }
-
     return ZMK_BEHAVIOR_OPAQUE;
 }
 
@@ -495,6 +607,21 @@ static const struct behavior_driver_api behavior_hold_tap_driver_api = {
     .binding_released = on_hold_tap_binding_released,
 };
 
+int behavior_hold_tap_listener(const zmk_event_t *eh);
+
+// Decide the undecided hold-tap as if its tapping term ran out, so the events it captured are
+// released before the event that did not fit. Releasing them may have made a queued hold-tap
+// undecided, which gets to look at the event like after a late timer decision.
+// If older events are still being released, the event is released after them instead.
+static int capture_queue_full(const zmk_event_t *eh) {
+    if (captured_events_releasing > 0) {
+        release_after_released_events((struct captured_event){.event = eh});
+        return ZMK_EV_EVENT_CAPTURED;
+    }
+    decide_hold_tap(undecided_hold_tap, HT_TIMER_EVENT);
+    return behavior_hold_tap_listener(eh);
+}
+
 static int position_state_changed_listener(const zmk_event_t *eh) {
     struct zmk_position_state_changed *ev = as_zmk_position_state_changed(eh);
 
@@ -521,9 +648,12 @@ static int position_state_changed_listener(const zmk_event_t *eh) {
     if (ev->timestamp >
         (undecided_hold_tap->timestamp + undecided_hold_tap->config->tapping_term_ms)) {
         decide_hold_tap(undecided_hold_tap, HT_TIMER_EVENT);
+        // Releasing the captured events may have made a queued hold-tap undecided, which gets
+        // to look at this event instead.
+        return position_state_changed_listener(eh);
     }
 
-    if (!ev->state && find_captured_keydown_event(ev->position) == NULL) {
+    if (!ev->state && !has_captured_keydown_event(ev->position)) {
         // no keydown event has been captured, let it bubble.
         // we'll catch modifiers later in modifier_state_changed_listener
         LOG_DBG("%d bubbling %d %s event", undecided_hold_tap->position, ev->position,
@@ -533,7 +663,9 @@ static int position_state_changed_listener(const zmk_event_t *eh) {
 
     LOG_DBG("%d capturing %d %s event", undecided_hold_tap->position, ev->position,
             ev->state ? "down" : "up");
-    capture_event(eh);
+    if (capture_event(eh) < 0) {
+        return capture_queue_full(eh);
+    }
     decide_hold_tap(undecided_hold_tap, ev->state ? HT_OTHER_KEY_DOWN : HT_OTHER_KEY_UP);
     return ZMK_EV_EVENT_CAPTURED;
 }
@@ -556,7 +688,9 @@ static int keycode_state_changed_listener(const zmk_event_t *eh) {
     // if a undecided_hold_tap is active.
     LOG_DBG("%d capturing 0x%02X %s event", undecided_hold_tap->position, ev->keycode,
             ev->state ? "down" : "up");
-    capture_event(eh);
+    if (capture_event(eh) < 0) {
+        return capture_queue_full(eh);
+    }
     return ZMK_EV_EVENT_CAPTURED;
 }
 
@@ -574,14 +708,10 @@ ZMK_SUBSCRIPTION(behavior_hold_tap, zmk_position_state_changed);
 // this should be modifiers_state_changed, but unfrotunately that's not implemented yet.
 ZMK_SUBSCRIPTION(behavior_hold_tap, zmk_keycode_state_changed);
 
-void behavior_hold_tap_timer_work_handler(struct k_work *item) {
-    struct active_hold_tap *hold_tap = CONTAINER_OF(item, struct active_hold_tap, work);
+void behavior_hold_tap_timer_handler(struct zmk_deadline *deadline) {
+    struct active_hold_tap *hold_tap = CONTAINER_OF(deadline, struct active_hold_tap, timer);
 
-    if (hold_tap->work_is_cancelled) {
-        clear_hold_tap(hold_tap);
-    } else {
-        decide_hold_tap(hold_tap, HT_TIMER_EVENT);
-    }
+    decide_hold_tap(hold_tap, HT_TIMER_EVENT);
 }
 
 static int behavior_hold_tap_init(const struct device *dev) {
@@ -589,7 +719,7 @@ static int behavior_hold_tap_init(const struct device *dev) {
 
     if (init_first_run) {
         for (int i = 0; i < ZMK_BHV_HOLD_TAP_MAX_HELD; i++) {
-            k_delayed_work_init(&active_hold_taps[i].work, behavior_hold_tap_timer_work_handler);
+            zmk_deadline_init(&active_hold_taps[i].timer, behavior_hold_tap_timer_handler);
             active_hold_taps[i].position = ZMK_BHV_HOLD_TAP_POSITION_NOT_USED;
         }
     }
@@ -603,8 +733,8 @@ static struct behavior_hold_tap_data behavior_hold_tap_data;
 #define KP_INST(n)                                                                                 \
     static struct behavior_hold_tap_config behavior_hold_tap_config_##n = {                        \
         .tapping_term_ms = DT_INST_PROP(n, tapping_term_ms),                                       \
-        .hold_behavior_dev = DT_LABEL(DT_INST_PHANDLE_BY_IDX(n, bindings, 0)),                     \
-        .tap_behavior_dev = DT_LABEL(DT_INST_PHANDLE_BY_IDX(n, bindings, 1)),                      \
+        .hold_behavior = {.behavior_dev = DT_LABEL(DT_INST_PHANDLE_BY_IDX(n, bindings, 0))},       \
+        .tap_behavior = {.behavior_dev = DT_LABEL(DT_INST_PHANDLE_BY_IDX(n, bindings, 1))},        \
         .quick_tap_ms = DT_INST_PROP(n, quick_tap_ms),                                             \
         .flavor = DT_ENUM_IDX(DT_DRV_INST(n), flavor),                                             \
         .retro_tap = DT_INST_PROP(n, retro_tap),                                                   \
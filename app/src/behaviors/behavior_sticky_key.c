@@ -12,6 +12,7 @@
 #include <zmk/behavior.h>
 
 #include <zmk/matrix.h>
+#include <zmk/deadline.h>
 #include <zmk/endpoints.h>
 #include <zmk/event_manager.h>
 #include <zmk/events/position_state_changed.h>
@@ -41,9 +42,8 @@ struct active_sticky_key {
     const struct behavior_sticky_key_config *config;
     // timer data.
     bool timer_started;
-    bool timer_cancelled;
     int64_t release_at;
-    struct k_delayed_work release_timer;
+    struct zmk_deadline release_timer;
     // usage page and keycode for the key that is being modified by this sticky key
     uint8_t modified_key_usage_page;
     uint32_t modified_key_keycode;
@@ -56,8 +56,7 @@ static struct active_sticky_key *store_sticky_key(uint32_t position, uint32_t pa
                                                   const struct behavior_sticky_key_config *config) {
     for (int i = 0; i < ZMK_BHV_STICKY_KEY_MAX_HELD; i++) {
         struct active_sticky_key *const sticky_key = &active_sticky_keys[i];
-        if (sticky_key->position != ZMK_BHV_STICKY_KEY_POSITION_FREE ||
-            sticky_key->timer_cancelled) {
+        if (sticky_key->position != ZMK_BHV_STICKY_KEY_POSITION_FREE) {
             continue;
         }
         sticky_key->position = position;
@@ -65,7 +64,6 @@ static struct active_sticky_key *store_sticky_key(uint32_t position, uint32_t pa
         sticky_key->param2 = param2;
         sticky_key->config = config;
         sticky_key->release_at = 0;
-        sticky_key->timer_cancelled = false;
         sticky_key->timer_started = false;
         sticky_key->modified_key_usage_page = 0;
         sticky_key->modified_key_keycode = 0;
@@ -80,7 +78,7 @@ static void clear_sticky_key(struct active_sticky_key *sticky_key) {
 
 static struct active_sticky_key *find_sticky_key(uint32_t position) {
     for (int i = 0; i < ZMK_BHV_STICKY_KEY_MAX_HELD; i++) {
-        if (active_sticky_keys[i].position == position && !active_sticky_keys[i].timer_cancelled) {
+        if (active_sticky_keys[i].position == position) {
             return &active_sticky_keys[i];
         }
     }
@@ -91,6 +89,7 @@ static inline int press_sticky_key_behavior(struct active_sticky_key *sticky_key
                                             int64_t timestamp) {
     struct zmk_behavior_binding binding = {
         .behavior_dev = sticky_key->config->behavior.behavior_dev,
+        .device = sticky_key->config->behavior.device,
         .param1 = sticky_key->param1,
         .param2 = sticky_key->param2,
     };
@@ -105,6 +104,7 @@ static inline int release_sticky_key_behavior(struct active_sticky_key *sticky_k
                                               int64_t timestamp) {
     struct zmk_behavior_binding binding = {
         .behavior_dev = sticky_key->config->behavior.behavior_dev,
+        .device = sticky_key->config->behavior.device,
         .param1 = sticky_key->param1,
         .param2 = sticky_key->param2,
     };
@@ -117,19 +117,16 @@ static inline int release_sticky_key_behavior(struct active_sticky_key *sticky_k
     return behavior_keymap_binding_released(&binding, event);
 }
 
-static int stop_timer(struct active_sticky_key *sticky_key) {
-    int timer_cancel_result = k_delayed_work_cancel(&sticky_key->release_timer);
-    if (timer_cancel_result == -EINPROGRESS) {
-        // too late to cancel, we'll let the timer handler clear up.
-        sticky_key->timer_cancelled = true;
-    }
-    return timer_cancel_result;
+static void stop_timer(struct active_sticky_key *sticky_key) {
+    zmk_deadline_cancel(&sticky_key->release_timer);
 }
 
 static int on_sticky_key_binding_pressed(struct zmk_behavior_binding *binding,
                                          struct zmk_behavior_binding_event event) {
-    const struct device *dev = device_get_binding(binding->behavior_dev);
+    const struct device *dev = zmk_behavior_binding_device(binding);
     const struct behavior_sticky_key_config *cfg = dev->config;
+    // Like mod-morph, the binding in the config caches its resolved device in place.
+    zmk_behavior_binding_device((struct zmk_behavior_binding *)&cfg->behavior);
     struct active_sticky_key *sticky_key;
     sticky_key = find_sticky_key(event.position);
     if (sticky_key != NULL) {
@@ -164,11 +161,8 @@ static int on_sticky_key_binding_released(struct zmk_behavior_binding *binding,
     // No other key was pressed. Start the timer.
     sticky_key->timer_started = true;
     sticky_key->release_at = event.timestamp + sticky_key->config->release_after_ms;
-    // adjust timer in case this behavior was queued by a hold-tap
-    int32_t ms_left = sticky_key->release_at - k_uptime_get();
-    if (ms_left > 0) {
-        k_delayed_work_submit(&sticky_key->release_timer, K_MSEC(ms_left));
-    }
+    // release_at is relative to the event, in case this behavior was queued by a hold-tap
+    zmk_deadline_schedule(&sticky_key->release_timer, sticky_key->release_at);
     return ZMK_BEHAVIOR_OPAQUE;
 }
 
@@ -237,25 +231,21 @@ static int sticky_key_keycode_state_changed_listener(const zmk_event_t *eh) {
     return ZMK_EV_EVENT_BUBBLE;
 }
 
-void behavior_sticky_key_timer_handler(struct k_work *item) {
+void behavior_sticky_key_timer_handler(struct zmk_deadline *deadline) {
     struct active_sticky_key *sticky_key =
-        CONTAINER_OF(item, struct active_sticky_key, release_timer);
+        CONTAINER_OF(deadline, struct active_sticky_key, release_timer);
     if (sticky_key->position == ZMK_BHV_STICKY_KEY_POSITION_FREE) {
         return;
     }
-    if (sticky_key->timer_cancelled) {
-        sticky_key->timer_cancelled = false;
-    } else {
-        release_sticky_key_behavior(sticky_key, sticky_key->release_at);
-    }
+    release_sticky_key_behavior(sticky_key, sticky_key->release_at);
 }
 
 static int behavior_sticky_key_init(const struct device *dev) {
     static bool init_first_run = true;
     if (init_first_run) {
         for (int i = 0; i < ZMK_BHV_STICKY_KEY_MAX_HELD; i++) {
-            k_delayed_work_init(&active_sticky_keys[i].release_timer,
-                                behavior_sticky_key_timer_handler);
+            zmk_deadline_init(&active_sticky_keys[i].release_timer,
+                              behavior_sticky_key_timer_handler);
             active_sticky_keys[i].position = ZMK_BHV_STICKY_KEY_POSITION_FREE;
         }
     }
@@ -30,6 +30,7 @@
 LOG_MODULE_DECLARE(zmk, CONFIG_ZMK_LOG_LEVEL);
 
 #include <zmk/ble.h>
+#include <zmk/ble/conn_params.h>
 #include <zmk/keys.h>
 #include <zmk/split/bluetooth/uuid.h>
 #include <zmk/event_manager.h>
@@ -40,7 +41,7 @@ static uint8_t passkey_entries[6] = {0, 0, 0, 0, 0, 0};
 static uint8_t passkey_digit = 0;
 
 #if IS_ENABLED(CONFIG_ZMK_SPLIT_BLE_ROLE_CENTRAL)
-#define PROFILE_COUNT (CONFIG_BT_MAX_PAIRED - 1)
+#define PROFILE_COUNT (CONFIG_BT_MAX_PAIRED - CONFIG_ZMK_SPLIT_BLE_CENTRAL_PERIPHERALS)
 #else
 #define PROFILE_COUNT CONFIG_BT_MAX_PAIRED
 #endif
@@ -66,9 +67,9 @@ static uint8_t active_profile;
 BUILD_ASSERT(DEVICE_NAME_LEN <= 16, "ERROR: BLE device name is too long. Max length: 16");
 
 #define IS_HOST_PERIPHERAL                                                                         \
-    (!IS_ENABLED(CONFIG_ZMK_SPLIT) || IS_ENABLED(CONFIG_ZMK_SPLIT_BLE_ROLE_CENTRAL))
+    (!IS_ENABLED(CONFIG_ZMK_SPLIT) || IS_ENABLED(CONFIG_ZMK_SPLIT_ROLE_CENTRAL))
 #define IS_SPLIT_PERIPHERAL                                                                        \
-    (IS_ENABLED(CONFIG_ZMK_SPLIT) && !IS_ENABLED(CONFIG_ZMK_SPLIT_BLE_ROLE_CENTRAL))
+    (IS_ENABLED(CONFIG_ZMK_SPLIT_BLE) && !IS_ENABLED(CONFIG_ZMK_SPLIT_BLE_ROLE_CENTRAL))
 
 static const struct bt_data zmk_ble_ad[] = {
 #if IS_HOST_PERIPHERAL
@@ -89,7 +90,9 @@ static const struct bt_data zmk_ble_ad[] = {
 
 #if IS_ENABLED(CONFIG_ZMK_SPLIT_BLE_ROLE_CENTRAL)
 
-static bt_addr_le_t peripheral_addr;
+static bt_addr_le_t peripheral_addrs[CONFIG_ZMK_SPLIT_BLE_CENTRAL_PERIPHERALS];
+// Set when the address was loaded from the ble/peripheral_address key used by older versions.
+static bool legacy_peripheral_address_loaded;
 
 #endif /* IS_ENABLED(CONFIG_ZMK_SPLIT_BLE_ROLE_CENTRAL) */
 
@@ -281,9 +284,24 @@ char *zmk_ble_active_profile_name() { return profiles[active_profile].name; }
 
 #if IS_ENABLED(CONFIG_ZMK_SPLIT_BLE_ROLE_CENTRAL)
 
-void zmk_ble_set_peripheral_addr(bt_addr_le_t *addr) {
-    memcpy(&peripheral_addr, addr, sizeof(bt_addr_le_t));
-    settings_save_one("ble/peripheral_address", addr, sizeof(bt_addr_le_t));
+int zmk_ble_put_peripheral_addr(const bt_addr_le_t *addr) {
+    for (int i = 0; i < ARRAY_SIZE(peripheral_addrs); i++) {
+        if (!bt_addr_le_cmp(&peripheral_addrs[i], addr)) {
+            return i;
+        }
+
+        // Slots are filled in order, so the first open one means the address is new.
+        if (!bt_addr_le_cmp(&peripheral_addrs[i], BT_ADDR_LE_ANY)) {
+            bt_addr_le_copy(&peripheral_addrs[i], addr);
+
+            char setting_name[32];
+            sprintf(setting_name, "ble/peripheral_addresses/%d", i);
+            settings_save_one(setting_name, addr, sizeof(bt_addr_le_t));
+            return i;
+        }
+    }
+
+    return -ENOMEM;
 }
 
 #endif /* IS_ENABLED(CONFIG_ZMK_SPLIT_BLE_ROLE_CENTRAL) */
@@ -337,16 +355,43 @@ static int ble_profiles_handle_set(const char *name, size_t len, settings_read_c
         }
     }
 #if IS_ENABLED(CONFIG_ZMK_SPLIT_BLE_ROLE_CENTRAL)
-    else if (settings_name_steq(name, "peripheral_address", &next) && !next) {
+    else if (settings_name_steq(name, "peripheral_addresses", &next) && next) {
+        char *endptr;
+        uint8_t idx = strtoul(next, &endptr, 10);
+        if (*endptr != '\0') {
+            LOG_WRN("Invalid peripheral index: %s", log_strdup(next));
+            return -EINVAL;
+        }
+
         if (len != sizeof(bt_addr_le_t)) {
             return -EINVAL;
         }
 
-        int err = read_cb(cb_arg, &peripheral_addr, sizeof(bt_addr_le_t));
+        if (idx >= ARRAY_SIZE(peripheral_addrs)) {
+            LOG_WRN("Peripheral address for index %d is larger than max of %d", idx,
+                    ARRAY_SIZE(peripheral_addrs));
+            return -EINVAL;
+        }
+
+        int err = read_cb(cb_arg, &peripheral_addrs[idx], sizeof(bt_addr_le_t));
+        if (err <= 0) {
+            LOG_ERR("Failed to handle peripheral address from settings (err %d)", err);
+            return err;
+        }
+    } else if (settings_name_steq(name, "peripheral_address", &next) && !next) {
+        // Stored before the central supported more than one peripheral.
+        if (len != sizeof(bt_addr_le_t)) {
+            return -EINVAL;
+        }
+
+        int err = read_cb(cb_arg, &peripheral_addrs[0], sizeof(bt_addr_le_t));
         if (err <= 0) {
             LOG_ERR("Failed to handle peripheral address from settings (err %d)", err);
             return err;
         }
+
+        // Moved to ble/peripheral_addresses/0 once loading is done.
+        legacy_peripheral_address_loaded = true;
     }
 #endif
 
@@ -375,10 +420,7 @@ static void connected(struct bt_conn *conn, uint8_t err) {
 
     LOG_DBG("Connected %s", log_strdup(addr));
 
-    err = bt_conn_le_param_update(conn, BT_LE_CONN_PARAM(0x0006, 0x000c, 30, 400));
-    if (err) {
-        LOG_WRN("Failed to update LE parameters (err %d)", err);
-    }
+    zmk_ble_conn_params_connected(conn);
 
 #if IS_SPLIT_PERIPHERAL
     bt_conn_le_phy_update(conn, BT_CONN_LE_PHY_PARAM_2M);
@@ -403,6 +445,8 @@ static void disconnected(struct bt_conn *conn, uint8_t reason) {
 
     LOG_DBG("Disconnected from %s (reason 0x%02x)", log_strdup(addr), reason);
 
+    zmk_ble_conn_params_disconnected(conn);
+
     // We need to do this in a work callback, otherwise the advertising update will still see the
     // connection for a profile as active, and not start advertising yet.
     k_work_submit(&update_advertising_work);
@@ -432,6 +476,8 @@ static void le_param_updated(struct bt_conn *conn, uint16_t interval, uint16_t l
     bt_addr_le_to_str(bt_conn_get_dst(conn), addr, sizeof(addr));
 
     LOG_DBG("%s: interval %d latency %d timeout %d", log_strdup(addr), interval, latency, timeout);
+
+    zmk_ble_conn_params_updated(conn, interval, latency, timeout);
 }
 
 static struct bt_conn_cb conn_callbacks = {
@@ -565,6 +611,23 @@ static int zmk_ble_init(const struct device *_arg) {
     settings_load_subtree("ble");
     settings_load_subtree("bt");
 
+#if IS_ENABLED(CONFIG_ZMK_SPLIT_BLE_ROLE_CENTRAL)
+    if (legacy_peripheral_address_loaded) {
+        LOG_DBG("Moving the peripheral address to ble/peripheral_addresses/0");
+
+        err = settings_save_one("ble/peripheral_addresses/0", &peripheral_addrs[0],
+                                sizeof(bt_addr_le_t));
+        if (err) {
+            LOG_ERR("Failed to save setting: %d", err);
+        } else {
+            err = settings_delete("ble/peripheral_address");
+            if (err) {
+                LOG_ERR("Failed to delete setting: %d", err);
+            }
+        }
+    }
+#endif
+
 #endif
 
 #if IS_ENABLED(CONFIG_ZMK_BLE_CLEAR_BONDS_ON_START)
@@ -583,6 +646,26 @@ static int zmk_ble_init(const struct device *_arg) {
             LOG_ERR("Failed to delete setting: %d", err);
         }
     }
+
+#if IS_ENABLED(CONFIG_ZMK_SPLIT_BLE_ROLE_CENTRAL)
+    // Otherwise new peripherals could not take the place of the unpaired ones.
+    for (int i = 0; i < ARRAY_SIZE(peripheral_addrs); i++) {
+        char setting_name[32];
+        sprintf(setting_name, "ble/peripheral_addresses/%d", i);
+
+        err = settings_delete(setting_name);
+        if (err) {
+            LOG_ERR("Failed to delete setting: %d", err);
+        }
+    }
+
+    err = settings_delete("ble/peripheral_address");
+    if (err) {
+        LOG_ERR("Failed to delete setting: %d", err);
+    }
+
+    memset(peripheral_addrs, 0, sizeof(peripheral_addrs));
+#endif
 #endif
 
     bt_conn_cb_register(&conn_callbacks);
@@ -0,0 +1,152 @@
+/*
+ * Copyright (c) 2020 The ZMK Contributors
+ *
+ * SPDX-License-Identifier: MIT
+ */
+
+#include <device.h>
+#include <init.h>
+#include <kernel.h>
+
+#include <bluetooth/bluetooth.h>
+#include <bluetooth/conn.h>
+
+#include <logging/log.h>
+
+LOG_MODULE_DECLARE(zmk, CONFIG_ZMK_LOG_LEVEL);
+
+#include <zmk/activity.h>
+#include <zmk/ble/conn_params.h>
+#include <zmk/deadline.h>
+#include <zmk/event_manager.h>
+#include <zmk/events/activity_state_changed.h>
+
+static const struct bt_le_conn_param active_params = BT_LE_CONN_PARAM_INIT(
+    CONFIG_ZMK_BLE_ACTIVE_CONN_INTERVAL_MIN, CONFIG_ZMK_BLE_ACTIVE_CONN_INTERVAL_MAX,
+    CONFIG_ZMK_BLE_ACTIVE_CONN_LATENCY, CONFIG_ZMK_BLE_CONN_TIMEOUT);
+
+static const struct bt_le_conn_param idle_params = BT_LE_CONN_PARAM_INIT(
+    CONFIG_ZMK_BLE_IDLE_CONN_INTERVAL_MIN, CONFIG_ZMK_BLE_IDLE_CONN_INTERVAL_MAX,
+    CONFIG_ZMK_BLE_IDLE_CONN_LATENCY, CONFIG_ZMK_BLE_CONN_TIMEOUT);
+
+struct conn_params_state {
+    bool requested;
+    bool requested_active;
+    int64_t requested_at;
+    bool negotiated;
+    struct zmk_ble_conn_params params;
+};
+
+static struct conn_params_state states[CONFIG_BT_MAX_CONN];
+
+// Fires once a rate limited connection may be updated again.
+static struct zmk_deadline retry_deadline;
+
+static void update_conn_params(struct bt_conn *conn, void *data) {
+    int64_t *retry_at = data;
+    struct bt_conn_info info;
+
+    if (bt_conn_get_info(conn, &info) != 0 || info.role != BT_CONN_ROLE_SLAVE) {
+        return;
+    }
+
+    struct conn_params_state *state = &states[bt_conn_index(conn)];
+    bool active = zmk_activity_get_state() == ZMK_ACTIVITY_ACTIVE;
+    if (state->requested && state->requested_active == active) {
+        return;
+    }
+
+    int64_t now = k_uptime_get();
+    int64_t allowed_at = state->requested_at + CONFIG_ZMK_BLE_CONN_PARAMS_UPDATE_MIN_INTERVAL;
+    if (state->requested && now < allowed_at) {
+        *retry_at = MIN(*retry_at, allowed_at);
+        return;
+    }
+
+    int err = bt_conn_le_param_update(conn, active ? &active_params : &idle_params);
+    if (err) {
+        LOG_WRN("Failed to update LE parameters (err %d)", err);
+        return;
+    }
+
+    LOG_DBG("Requested %s connection parameters", active ? "active" : "idle");
+    state->requested = true;
+    state->requested_active = active;
+    state->requested_at = now;
+}
+
+static void update_all_conn_params() {
+    int64_t retry_at = INT64_MAX;
+
+    bt_conn_foreach(BT_CONN_TYPE_LE, update_conn_params, &retry_at);
+
+    if (retry_at != INT64_MAX) {
+        zmk_deadline_schedule(&retry_deadline, retry_at);
+    } else {
+        zmk_deadline_cancel(&retry_deadline);
+    }
+}
+
+static void retry_deadline_handler(struct zmk_deadline *deadline) { update_all_conn_params(); }
+
+static void update_conn_params_work_handler(struct k_work *work) { update_all_conn_params(); }
+
+K_WORK_DEFINE(update_conn_params_work, update_conn_params_work_handler);
+
+void zmk_ble_conn_params_connected(struct bt_conn *conn) {
+    struct bt_conn_info info;
+
+    memset(&states[bt_conn_index(conn)], 0, sizeof(struct conn_params_state));
+
+    if (bt_conn_get_info(conn, &info) == 0) {
+        zmk_ble_conn_params_updated(conn, info.le.interval, info.le.latency, info.le.timeout);
+    }
+
+    // Connection callbacks run on the Bluetooth thread, the policy runs on the system work queue.
+    k_work_submit(&update_conn_params_work);
+}
+
+void zmk_ble_conn_params_disconnected(struct bt_conn *conn) {
+    memset(&states[bt_conn_index(conn)], 0, sizeof(struct conn_params_state));
+}
+
+void zmk_ble_conn_params_updated(struct bt_conn *conn, uint16_t interval, uint16_t latency,
+                                 uint16_t timeout) {
+    struct conn_params_state *state = &states[bt_conn_index(conn)];
+
+    state->params = (struct zmk_ble_conn_params){
+        .interval = interval,
+        .latency = latency,
+        .timeout = timeout,
+    };
+    state->negotiated = true;
+
+    LOG_INF("Connection parameters: interval %dus latency %d timeout %dms",
+            interval * 1250, latency, timeout * 10);
+}
+
+int zmk_ble_conn_params_get(struct bt_conn *conn, struct zmk_ble_conn_params *params) {
+    const struct conn_params_state *state = &states[bt_conn_index(conn)];
+
+    if (!state->negotiated) {
+        return -ENOTCONN;
+    }
+
+    *params = state->params;
+    return 0;
+}
+
+static int conn_params_listener(const zmk_event_t *eh) {
+    update_all_conn_params();
+    return 0;
+}
+
+ZMK_LISTENER(ble_conn_params, conn_params_listener);
+ZMK_SUBSCRIPTION(ble_conn_params, zmk_activity_state_changed);
+
+static int zmk_ble_conn_params_init(const struct device *_arg) {
+    zmk_deadline_init(&retry_deadline, retry_deadline_handler);
+    return 0;
+}
+
+SYS_INIT(zmk_ble_conn_params_init, APPLICATION, CONFIG_APPLICATION_INIT_PRIORITY);
@@ -13,6 +13,7 @@
 #include <kernel.h>
 
 #include <zmk/behavior.h>
+#include <zmk/deadline.h>
 #include <zmk/event_manager.h>
 #include <zmk/events/position_state_changed.h>
 #include <zmk/hid.h>
@@ -23,6 +24,13 @@ LOG_MODULE_DECLARE(zmk, CONFIG_ZMK_LOG_LEVEL);
 
 #if DT_HAS_COMPAT_STATUS_OKAY(DT_DRV_COMPAT)
 
+#if IS_ENABLED(CONFIG_ZMK_COMBO_ENGINE_BITMASK)
+#define COMBO_ONE(n) 1 +
+#define COMBO_COUNT (DT_INST_FOREACH_CHILD(0, COMBO_ONE) 0)
+#define COMBO_WORDS ceiling_fraction(COMBO_COUNT, 32)
+#define POSITION_WORDS ceiling_fraction(ZMK_KEYMAP_LEN, 32)
+#endif
+
 struct combo_cfg {
     int32_t key_positions[CONFIG_ZMK_COMBO_MAX_KEYS_PER_COMBO];
     int32_t key_position_len;
@@ -34,6 +42,10 @@ struct combo_cfg {
     // the virtual key position is a key position outside the range used by the keyboard.
     // it is necessary so hold-taps can uniquely identify a behavior.
     int32_t virtual_key_position;
+#if IS_ENABLED(CONFIG_ZMK_COMBO_ENGINE_BITMASK)
+    // key_positions as a bitmask, filled in by initialize_combo.
+    uint32_t key_mask[POSITION_WORDS];
+#endif
     int32_t layers_len;
     int8_t layers[];
 };
@@ -46,6 +58,7 @@ struct active_combo {
     const zmk_event_t *key_positions_pressed[CONFIG_ZMK_COMBO_MAX_KEYS_PER_COMBO];
 };
 
+#if !IS_ENABLED(CONFIG_ZMK_COMBO_ENGINE_BITMASK)
 struct combo_candidate {
     struct combo_cfg *combo;
     // the time after which this behavior should be removed from candidates.
@@ -53,23 +66,77 @@ struct combo_candidate {
     // possibility of accidental releases.
     int64_t timeout_at;
 };
+#endif
 
 // set of keys pressed
 const zmk_event_t *pressed_keys[CONFIG_ZMK_COMBO_MAX_KEYS_PER_COMBO] = {NULL};
-// the set of candidate combos based on the currently pressed_keys
-struct combo_candidate candidates[CONFIG_ZMK_COMBO_MAX_COMBOS_PER_KEY];
 // the last candidate that was completely pressed
 struct combo_cfg *fully_pressed_combo = NULL;
+#if IS_ENABLED(CONFIG_ZMK_COMBO_ENGINE_BITMASK)
+// all combos, sorted shortest-first, then by virtual-key-position.
+struct combo_cfg *combos[COMBO_COUNT] = {NULL};
+int combo_count = 0;
+// for each key position, the combos using it, one bit per index in combos
+uint32_t position_combos[ZMK_KEYMAP_LEN][COMBO_WORDS] = {0};
+// the key positions of pressed_keys
+uint32_t pressed_positions[POSITION_WORDS] = {0};
+// the set of candidate combos based on the currently pressed_keys, one bit per index in combos
+uint32_t candidates[COMBO_WORDS] = {0};
+// timestamp of the first of pressed_keys, candidates time out relative to it
+int64_t candidates_pressed_at;
+#else
+// the set of candidate combos based on the currently pressed_keys
+struct combo_candidate candidates[CONFIG_ZMK_COMBO_MAX_COMBOS_PER_KEY];
 // a lookup dict that maps a key position to all combos on that position
 struct combo_cfg *combo_lookup[ZMK_KEYMAP_LEN][CONFIG_ZMK_COMBO_MAX_COMBOS_PER_KEY] = {NULL};
+#endif
 // combos that have been activated and still have (some) keys pressed
 // this array is always contiguous from 0.
 struct active_combo active_combos[CONFIG_ZMK_COMBO_MAX_PRESSED_COMBOS] = {NULL};
 int active_combo_count = 0;
 
-struct k_delayed_work timeout_task;
-int64_t timeout_task_timeout_at;
+struct zmk_deadline timeout_deadline;
 
+#if IS_ENABLED(CONFIG_ZMK_COMBO_ENGINE_BITMASK)
+static inline bool position_in_mask(const uint32_t *mask, int32_t position) {
+    return (mask[position / 32] & BIT(position % 32)) != 0;
+}
+
+static inline bool combo_sorts_before(struct combo_cfg *a, struct combo_cfg *b) {
+    return a->key_position_len < b->key_position_len ||
+           (a->key_position_len == b->key_position_len &&
+            a->virtual_key_position < b->virtual_key_position);
+}
+
+// Fill in the key mask of the combo and insert it in the sorted combos array.
+static int initialize_combo(struct combo_cfg *new_combo) {
+    for (int i = 0; i < new_combo->key_position_len; i++) {
+        int32_t position = new_combo->key_positions[i];
+        if (position >= ZMK_KEYMAP_LEN) {
+            LOG_ERR("Unable to initialize combo, key position %d does not exist", position);
+            return -EINVAL;
+        }
+        new_combo->key_mask[position / 32] |= BIT(position % 32);
+    }
+
+    int i = combo_count++;
+    for (; i > 0 && combo_sorts_before(new_combo, combos[i - 1]); i--) {
+        combos[i] = combos[i - 1];
+    }
+    combos[i] = new_combo;
+    return 0;
+}
+
+// Build position_combos once all combos are sorted, since inserting a combo shifts the indices.
+static void index_combo_positions() {
+    for (int i = 0; i < combo_count; i++) {
+        struct combo_cfg *combo = combos[i];
+        for (int j = 0; j < combo->key_position_len; j++) {
+            position_combos[combo->key_positions[j]][i / 32] |= BIT(i % 32);
+        }
+    }
+}
+#else
 // Store the combo key pointer in the combos array, one pointer for each key position
 // The combos are sorted shortest-first, then by virtual-key-position.
 static int initialize_combo(struct combo_cfg *new_combo) {
@@ -106,6 +173,7 @@ static int initialize_combo(struct combo_cfg *new_combo) {
     }
     return 0;
 }
+#endif
 
 static bool combo_active_on_layer(struct combo_cfg *combo, uint8_t layer) {
     if (combo->layers[0] == -1) {
@@ -120,6 +188,68 @@ static bool combo_active_on_layer(struct combo_cfg *combo, uint8_t layer) {
     return false;
 }
 
+#if IS_ENABLED(CONFIG_ZMK_COMBO_ENGINE_BITMASK)
+static int setup_candidates_for_first_keypress(int32_t position, int64_t timestamp) {
+    int number_of_combo_candidates = 0;
+    uint8_t highest_active_layer = zmk_keymap_highest_layer_active();
+    candidates_pressed_at = timestamp;
+    for (int word = 0; word < COMBO_WORDS; word++) {
+        for (uint32_t bits = position_combos[position][word]; bits != 0; bits &= bits - 1) {
+            int bit = __builtin_ctz(bits);
+            if (combo_active_on_layer(combos[word * 32 + bit], highest_active_layer)) {
+                candidates[word] |= BIT(bit);
+                number_of_combo_candidates++;
+            }
+        }
+    }
+    return number_of_combo_candidates;
+}
+
+static int filter_candidates(int32_t position) {
+    // candidates already contain the other pressed keys, so a candidate's key mask is still a
+    // superset of the pressed positions iff it contains the new position.
+    int matches = 0;
+    for (int word = 0; word < COMBO_WORDS; word++) {
+        for (uint32_t bits = candidates[word]; bits != 0; bits &= bits - 1) {
+            int bit = __builtin_ctz(bits);
+            if (position_in_mask(combos[word * 32 + bit]->key_mask, position)) {
+                matches++;
+            } else {
+                candidates[word] &= ~BIT(bit);
+            }
+        }
+    }
+    return matches;
+}
+
+static int64_t first_candidate_timeout() {
+    int64_t first_timeout = LLONG_MAX;
+    for (int word = 0; word < COMBO_WORDS; word++) {
+        for (uint32_t bits = candidates[word]; bits != 0; bits &= bits - 1) {
+            int64_t timeout_at =
+                candidates_pressed_at + combos[word * 32 + __builtin_ctz(bits)]->timeout_ms;
+            if (timeout_at < first_timeout) {
+                first_timeout = timeout_at;
+            }
+        }
+    }
+    return first_timeout;
+}
+
+// the shortest candidate, or NULL if there are no candidates.
+static inline struct combo_cfg *first_candidate() {
+    for (int word = 0; word < COMBO_WORDS; word++) {
+        if (candidates[word] != 0) {
+            return combos[word * 32 + __builtin_ctz(candidates[word])];
+        }
+    }
+    return NULL;
+}
+
+static inline bool candidate_is_completely_pressed(struct combo_cfg *candidate) {
+    return memcmp(pressed_positions, candidate->key_mask, sizeof(pressed_positions)) == 0;
+}
+#else
 static int setup_candidates_for_first_keypress(int32_t position, int64_t timestamp) {
     int number_of_combo_candidates = 0;
     uint8_t highest_active_layer = zmk_keymap_highest_layer_active();
@@ -185,15 +315,44 @@ static int64_t first_candidate_timeout() {
     return first_timeout;
 }
 
+// the shortest candidate, or NULL if there are no candidates.
+static inline struct combo_cfg *first_candidate() { return candidates[0].combo; }
+
 static inline bool candidate_is_completely_pressed(struct combo_cfg *candidate) {
     // this code assumes set(pressed_keys) <= set(candidate->key_positions)
     // this invariant is enforced by filter_candidates
     // the only thing we need to do is check if len(pressed_keys) == len(combo->key_positions)
     return pressed_keys[candidate->key_position_len - 1] != NULL;
 }
+#endif
 
 static int cleanup();
 
+#if IS_ENABLED(CONFIG_ZMK_COMBO_ENGINE_BITMASK)
+static int filter_timed_out_candidates(int64_t timestamp) {
+    int num_candidates = 0;
+    for (int word = 0; word < COMBO_WORDS; word++) {
+        for (uint32_t bits = candidates[word]; bits != 0; bits &= bits - 1) {
+            int bit = __builtin_ctz(bits);
+            if (candidates_pressed_at + combos[word * 32 + bit]->timeout_ms > timestamp) {
+                num_candidates++;
+            } else {
+                candidates[word] &= ~BIT(bit);
+            }
+        }
+    }
+    return num_candidates;
+}
+
+static int clear_candidates() {
+    int num_candidates = 0;
+    for (int word = 0; word < COMBO_WORDS; word++) {
+        num_candidates += __builtin_popcount(candidates[word]);
+        candidates[word] = 0;
+    }
+    return num_candidates;
+}
+#else
 static int filter_timed_out_candidates(int64_t timestamp) {
     int num_candidates = 0;
     for (int i = 0; i < CONFIG_ZMK_COMBO_MAX_COMBOS_PER_KEY; i++) {
@@ -222,6 +381,7 @@ static int clear_candidates() {
     }
     return CONFIG_ZMK_COMBO_MAX_COMBOS_PER_KEY;
 }
+#endif
 
 static int capture_pressed_key(const zmk_event_t *ev) {
     for (int i = 0; i < CONFIG_ZMK_COMBO_MAX_KEYS_PER_COMBO; i++) {
@@ -229,6 +389,10 @@ static int capture_pressed_key(const zmk_event_t *ev) {
             continue;
         }
         pressed_keys[i] = ev;
+#if IS_ENABLED(CONFIG_ZMK_COMBO_ENGINE_BITMASK)
+        int32_t position = as_zmk_position_state_changed(ev)->position;
+        pressed_positions[position / 32] |= BIT(position % 32);
+#endif
         return ZMK_EV_EVENT_CAPTURED;
     }
     return 0;
@@ -237,6 +401,9 @@ static int capture_pressed_key(const zmk_event_t *ev) {
 const struct zmk_listener zmk_listener_combo;
 
 static int release_pressed_keys() {
+#if IS_ENABLED(CONFIG_ZMK_COMBO_ENGINE_BITMASK)
+    memset(pressed_positions, 0, sizeof(pressed_positions));
+#endif
     for (int i = 0; i < CONFIG_ZMK_COMBO_MAX_KEYS_PER_COMBO; i++) {
         const zmk_event_t *captured_event = pressed_keys[i];
         if (pressed_keys[i] == NULL) {
@@ -363,7 +530,7 @@ static bool release_combo_key(int32_t position, int64_t timestamp) {
 }
 
 static int cleanup() {
-    k_delayed_work_cancel(&timeout_task);
+    zmk_deadline_cancel(&timeout_deadline);
     clear_candidates();
     if (fully_pressed_combo != NULL) {
         activate_combo(fully_pressed_combo);
@@ -374,22 +541,16 @@ static int cleanup() {
 
 static void update_timeout_task() {
     int64_t first_timeout = first_candidate_timeout();
-    if (timeout_task_timeout_at == first_timeout) {
-        return;
-    }
     if (first_timeout == LLONG_MAX) {
-        timeout_task_timeout_at = 0;
-        k_delayed_work_cancel(&timeout_task);
+        zmk_deadline_cancel(&timeout_deadline);
         return;
     }
-    if (k_delayed_work_submit(&timeout_task, K_MSEC(first_timeout - k_uptime_get())) == 0) {
-        timeout_task_timeout_at = first_timeout;
-    }
+    zmk_deadline_schedule(&timeout_deadline, first_timeout);
 }
 
 static int position_state_down(const zmk_event_t *ev, struct zmk_position_state_changed *data) {
     int num_candidates;
-    if (candidates[0].combo == NULL) {
+    if (first_candidate() == NULL) {
         num_candidates = setup_candidates_for_first_keypress(data->position, data->timestamp);
         if (num_candidates == 0) {
             return 0;
@@ -400,7 +561,7 @@ static int position_state_down(const zmk_event_t *ev, struct zmk_position_state_
     }
     update_timeout_task();
 
-    struct combo_cfg *candidate_combo = candidates[0].combo;
+    struct combo_cfg *candidate_combo = first_candidate();
     LOG_DBG("combo: capturing position event %d", data->position);
     int ret = capture_pressed_key(ev);
     switch (num_candidates) {
@@ -435,12 +596,8 @@ static int position_state_up(const zmk_event_t *ev, struct zmk_position_state_ch
     return 0;
 }
 
-static void combo_timeout_handler(struct k_work *item) {
-    if (timeout_task_timeout_at == 0 || k_uptime_get() < timeout_task_timeout_at) {
-        // timer was cancelled or rescheduled.
-        return;
-    }
-    if (filter_timed_out_candidates(timeout_task_timeout_at) < 2) {
+static void combo_timeout_handler(struct zmk_deadline *deadline) {
+    if (filter_timed_out_candidates(deadline->expires_at) < 2) {
         cleanup();
     }
     update_timeout_task();
@@ -489,8 +646,11 @@ ZMK_SUBSCRIPTION(combo, zmk_position_state_changed);
 DT_INST_FOREACH_CHILD(0, COMBO_INST)
 
 static int combo_init() {
-    k_delayed_work_init(&timeout_task, combo_timeout_handler);
+    zmk_deadline_init(&timeout_deadline, combo_timeout_handler);
     DT_INST_FOREACH_CHILD(0, INITIALIZE_COMBO);
+#if IS_ENABLED(CONFIG_ZMK_COMBO_ENGINE_BITMASK)
+    index_combo_positions();
+#endif
     return 0;
 }
 
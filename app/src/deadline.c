@@ -0,0 +1,95 @@
+/*
+ * Copyright (c) 2020 The ZMK Contributors
+ *
+ * SPDX-License-Identifier: MIT
+ */
+
+#include <device.h>
+#include <init.h>
+#include <kernel.h>
+#include <sys/dlist.h>
+
+#include <zmk/deadline.h>
+
+// Scheduled deadlines, sorted by expiry time. Only a handful of hold-taps, sticky keys and
+// combos are ever pending at once, so a sorted list beats a heap or timer wheel here.
+static sys_dlist_t deadlines = SYS_DLIST_STATIC_INIT(&deadlines);
+
+static struct k_delayed_work deadline_work;
+
+// The expiry time deadline_work is submitted for, 0 if it is not submitted.
+static int64_t deadline_work_expires_at;
+
+static void update_deadline_work() {
+    struct zmk_deadline *first = SYS_DLIST_PEEK_HEAD_CONTAINER(&deadlines, first, node);
+    if (first == NULL) {
+        if (deadline_work_expires_at != 0) {
+            k_delayed_work_cancel(&deadline_work);
+            deadline_work_expires_at = 0;
+        }
+        return;
+    }
+
+    if (first->expires_at == deadline_work_expires_at) {
+        return;
+    }
+
+    int64_t ms_left = first->expires_at - k_uptime_get();
+    k_delayed_work_submit(&deadline_work, K_MSEC(MAX(ms_left, 0)));
+    deadline_work_expires_at = first->expires_at;
+}
+
+static void deadline_work_handler(struct k_work *work) {
+    deadline_work_expires_at = 0;
+
+    int64_t now = k_uptime_get();
+    struct zmk_deadline *first;
+    // Handlers may schedule and cancel deadlines, so look at the head again after each one.
+    while ((first = SYS_DLIST_PEEK_HEAD_CONTAINER(&deadlines, first, node)) != NULL &&
+           first->expires_at <= now) {
+        sys_dlist_remove(&first->node);
+        first->handler(first);
+    }
+
+    update_deadline_work();
+}
+
+static int expires_after(sys_dnode_t *node, void *data) {
+    return CONTAINER_OF(node, struct zmk_deadline, node)->expires_at > *(int64_t *)data;
+}
+
+void zmk_deadline_init(struct zmk_deadline *deadline, zmk_deadline_handler_t handler) {
+    sys_dnode_init(&deadline->node);
+    deadline->expires_at = 0;
+    deadline->handler = handler;
+}
+
+void zmk_deadline_schedule(struct zmk_deadline *deadline, int64_t expires_at) {
+    if (zmk_deadline_is_scheduled(deadline)) {
+        if (deadline->expires_at == expires_at) {
+            return;
+        }
+        sys_dlist_remove(&deadline->node);
+    }
+
+    deadline->expires_at = expires_at;
+    sys_dlist_insert_at(&deadlines, &deadline->node, expires_after, &expires_at);
+    update_deadline_work();
+}
+
+bool zmk_deadline_cancel(struct zmk_deadline *deadline) {
+    if (!zmk_deadline_is_scheduled(deadline)) {
+        return false;
+    }
+
+    sys_dlist_remove(&deadline->node);
+    update_deadline_work();
+    return true;
+}
+
+static int zmk_deadline_service_init(const struct device *_arg) {
+    k_delayed_work_init(&deadline_work, deadline_work_handler);
+    return 0;
+}
+
+SYS_INIT(zmk_deadline_service_init, APPLICATION, CONFIG_APPLICATION_INIT_PRIORITY);
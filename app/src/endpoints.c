@@ -14,6 +14,7 @@
 #include <zmk/usb.h>
 #include <zmk/hog.h>
 #include <zmk/event_manager.h>
+#include <zmk/event_trace.h>
 #include <zmk/events/ble_active_profile_changed.h>
 #include <zmk/events/usb_conn_state_changed.h>
 
@@ -29,6 +30,17 @@ static enum zmk_endpoint preferred_endpoint =
 
 static void update_current_endpoint();
 
+// The report bodies the current endpoint received last, identical reports are not sent again.
+static struct zmk_hid_keyboard_report_body last_keyboard_report;
+static struct zmk_hid_consumer_report_body last_consumer_report;
+static bool keyboard_report_sent = false;
+static bool consumer_report_sent = false;
+
+#if IS_ENABLED(CONFIG_ZMK_ENDPOINTS_COALESCE_REPORTS)
+static bool keyboard_report_queued = false;
+static bool consumer_report_queued = false;
+#endif
+
 #if IS_ENABLED(CONFIG_SETTINGS)
 static void endpoints_save_preferred_work(struct k_work *work) {
     settings_save_one("endpoints/preferred", &preferred_endpoint, sizeof(preferred_endpoint));
@@ -76,6 +88,17 @@ static int send_keyboard_report() {
     switch (current_endpoint) {
 #if IS_ENABLED(CONFIG_ZMK_USB)
     case ZMK_ENDPOINT_USB: {
+#if IS_ENABLED(CONFIG_ZMK_USB_BOOT)
+        if (zmk_usb_hid_get_protocol() == HID_PROTOCOL_BOOT) {
+            int err = zmk_usb_hid_send_report((uint8_t *)zmk_hid_get_boot_report(),
+                                              sizeof(struct zmk_hid_boot_report));
+            if (err) {
+                LOG_ERR("FAILED TO SEND OVER USB: %d", err);
+            }
+            return err;
+        }
+#endif /* IS_ENABLED(CONFIG_ZMK_USB_BOOT) */
+
         int err = zmk_usb_hid_send_report((uint8_t *)keyboard_report, sizeof(*keyboard_report));
         if (err) {
             LOG_ERR("FAILED TO SEND OVER USB: %d", err);
@@ -106,6 +129,13 @@ static int send_consumer_report() {
     switch (current_endpoint) {
 #if IS_ENABLED(CONFIG_ZMK_USB)
     case ZMK_ENDPOINT_USB: {
+#if IS_ENABLED(CONFIG_ZMK_USB_BOOT)
+        // Boot protocol hosts only understand the keyboard report.
+        if (zmk_usb_hid_get_protocol() == HID_PROTOCOL_BOOT) {
+            return 0;
+        }
+#endif /* IS_ENABLED(CONFIG_ZMK_USB_BOOT) */
+
         int err = zmk_usb_hid_send_report((uint8_t *)consumer_report, sizeof(*consumer_report));
         if (err) {
             LOG_ERR("FAILED TO SEND OVER USB: %d", err);
@@ -130,18 +160,92 @@ static int send_consumer_report() {
     }
 }
 
+static int send_report_if_changed(const void *body, void *last_body, size_t len, bool *sent,
+                                  int (*send)()) {
+    if (*sent && memcmp(body, last_body, len) == 0) {
+        LOG_DBG("Report unchanged, not sending");
+        zmk_event_trace_report_skipped();
+        return 0;
+    }
+
+    zmk_event_trace_report();
+    int err = send();
+    if (err) {
+        return err;
+    }
+
+    memcpy(last_body, body, len);
+    *sent = true;
+    return 0;
+}
+
+static int send_report(uint16_t usage_page) {
+    switch (usage_page) {
+    case HID_USAGE_KEY:
+        return send_report_if_changed(&zmk_hid_get_keyboard_report()->body, &last_keyboard_report,
+                                      sizeof(last_keyboard_report), &keyboard_report_sent,
+                                      send_keyboard_report);
+    case HID_USAGE_CONSUMER:
+        return send_report_if_changed(&zmk_hid_get_consumer_report()->body, &last_consumer_report,
+                                      sizeof(last_consumer_report), &consumer_report_sent,
+                                      send_consumer_report);
+    default:
+        LOG_ERR("Unsupported usage page %d", usage_page);
+        return -ENOTSUP;
+    }
+}
+
+#if IS_ENABLED(CONFIG_ZMK_ENDPOINTS_COALESCE_REPORTS)
+
+static void send_queued_reports_work(struct k_work *work) { zmk_endpoints_flush_reports(); }
+
+K_WORK_DEFINE(queued_reports_work, send_queued_reports_work);
+
+#endif /* IS_ENABLED(CONFIG_ZMK_ENDPOINTS_COALESCE_REPORTS) */
+
 int zmk_endpoints_send_report(uint16_t usage_page) {
 
     LOG_DBG("usage page 0x%02X", usage_page);
+#if IS_ENABLED(CONFIG_ZMK_ENDPOINTS_COALESCE_REPORTS)
     switch (usage_page) {
     case HID_USAGE_KEY:
-        return send_keyboard_report();
+        keyboard_report_queued = true;
+        break;
     case HID_USAGE_CONSUMER:
-        return send_consumer_report();
+        consumer_report_queued = true;
+        break;
     default:
         LOG_ERR("Unsupported usage page %d", usage_page);
         return -ENOTSUP;
     }
+
+    // Queued after the work item raising this report, so everything else it changes is merged.
+    k_work_submit(&queued_reports_work);
+    return 0;
+#else
+    return send_report(usage_page);
+#endif
+}
+
+int zmk_endpoints_flush_reports() {
+#if IS_ENABLED(CONFIG_ZMK_ENDPOINTS_COALESCE_REPORTS)
+    int err = 0;
+
+    if (keyboard_report_queued) {
+        keyboard_report_queued = false;
+        err = send_report(HID_USAGE_KEY);
+    }
+
+    if (consumer_report_queued) {
+        consumer_report_queued = false;
+        int consumer_err = send_report(HID_USAGE_CONSUMER);
+        err = err ? err : consumer_err;
+    }
+
+    return err;
+#else
+    return 0;
+#endif
 }
 
 #if IS_ENABLED(CONFIG_SETTINGS)
@@ -231,6 +335,7 @@ static void disconnect_current_endpoint() {
 
     zmk_endpoints_send_report(HID_USAGE_KEY);
     zmk_endpoints_send_report(HID_USAGE_CONSUMER);
+    zmk_endpoints_flush_reports();
 }
 
 static void update_current_endpoint() {
@@ -243,6 +348,11 @@ static void update_current_endpoint() {
         current_endpoint = new_endpoint;
         LOG_INF("Endpoint changed: %d", current_endpoint);
     }
+
+    // The endpoint, BLE profile or USB state may have changed, so the host might not have seen
+    // the last reports. Make sure the next ones are sent even if they did not change.
+    keyboard_report_sent = false;
+    consumer_report_sent = false;
 }
 
 static int endpoint_listener(const zmk_event_t *eh) {
@@ -17,15 +17,116 @@ extern struct zmk_event_type *__event_type_end[];
 extern struct zmk_event_subscription __event_subscriptions_start[];
 extern struct zmk_event_subscription __event_subscriptions_end[];
 
+#if IS_ENABLED(CONFIG_ZMK_EVENT_MANAGER_SLABS)
+
+BUILD_ASSERT(CONFIG_ZMK_EVENT_MANAGER_SLAB_SMALL_BLOCK_SIZE % 4 == 0,
+             "Small event slab block size must be a multiple of 4");
+BUILD_ASSERT(CONFIG_ZMK_EVENT_MANAGER_SLAB_LARGE_BLOCK_SIZE % 4 == 0,
+             "Large event slab block size must be a multiple of 4");
+BUILD_ASSERT(CONFIG_ZMK_EVENT_MANAGER_SLAB_SMALL_BLOCK_SIZE <=
+                 CONFIG_ZMK_EVENT_MANAGER_SLAB_LARGE_BLOCK_SIZE,
+             "Small event slab blocks must not be larger than large event slab blocks");
+
+K_MEM_SLAB_DEFINE(event_slab_small, CONFIG_ZMK_EVENT_MANAGER_SLAB_SMALL_BLOCK_SIZE,
+                  CONFIG_ZMK_EVENT_MANAGER_SLAB_SMALL_BLOCK_COUNT, 8);
+K_MEM_SLAB_DEFINE(event_slab_large, CONFIG_ZMK_EVENT_MANAGER_SLAB_LARGE_BLOCK_SIZE,
+                  CONFIG_ZMK_EVENT_MANAGER_SLAB_LARGE_BLOCK_COUNT, 8);
+
+#endif /* IS_ENABLED(CONFIG_ZMK_EVENT_MANAGER_SLABS) */
+
+static struct zmk_event_manager_alloc_stats alloc_stats;
+
+#if IS_ENABLED(CONFIG_ZMK_EVENT_MANAGER_SLABS)
+
+static bool slab_owns(const struct k_mem_slab *slab, const void *block) {
+    const char *ptr = block;
+    return ptr >= slab->buffer && ptr < slab->buffer + (slab->num_blocks * slab->block_size);
+}
+
+static void *slab_alloc(struct k_mem_slab *slab, uint32_t *allocs, uint32_t *exhausted) {
+    void *block;
+    if (k_mem_slab_alloc(slab, &block, K_NO_WAIT) == 0) {
+        (*allocs)++;
+        return block;
+    }
+    (*exhausted)++;
+    return NULL;
+}
+
+#endif /* IS_ENABLED(CONFIG_ZMK_EVENT_MANAGER_SLABS) */
+
+void *zmk_event_manager_alloc(size_t size) {
+    void *event = NULL;
+
+#if IS_ENABLED(CONFIG_ZMK_EVENT_MANAGER_SLABS)
+    // Events that don't fit in a small block, or arrive while the small slab is exhausted,
+    // overflow into the large slab before the exhausted policy kicks in.
+    if (size <= CONFIG_ZMK_EVENT_MANAGER_SLAB_SMALL_BLOCK_SIZE) {
+        event = slab_alloc(&event_slab_small, &alloc_stats.small_slab_allocs,
+                           &alloc_stats.small_slab_exhausted);
+    }
+    if (event == NULL && size <= CONFIG_ZMK_EVENT_MANAGER_SLAB_LARGE_BLOCK_SIZE) {
+        event = slab_alloc(&event_slab_large, &alloc_stats.large_slab_allocs,
+                           &alloc_stats.large_slab_exhausted);
+    }
+    if (event != NULL) {
+        return event;
+    }
+
+#if IS_ENABLED(CONFIG_ZMK_EVENT_MANAGER_SLAB_EXHAUSTED_DROP)
+    alloc_stats.failed_allocs++;
+    LOG_ERR("No event slab block available for event of size %zu, dropping it", size);
+    return NULL;
+#else
+    LOG_WRN("No event slab block available for event of size %zu, using the heap", size);
+#endif /* IS_ENABLED(CONFIG_ZMK_EVENT_MANAGER_SLAB_EXHAUSTED_DROP) */
+#endif /* IS_ENABLED(CONFIG_ZMK_EVENT_MANAGER_SLABS) */
+
+    event = k_malloc(size);
+    if (event == NULL) {
+        alloc_stats.failed_allocs++;
+        LOG_ERR("Unable to allocate event of size %zu", size);
+        return NULL;
+    }
+    alloc_stats.heap_allocs++;
+    return event;
+}
+
+void zmk_event_manager_free(void *event) {
+#if IS_ENABLED(CONFIG_ZMK_EVENT_MANAGER_SLABS)
+    if (slab_owns(&event_slab_small, event)) {
+        k_mem_slab_free(&event_slab_small, &event);
+        return;
+    }
+    if (slab_owns(&event_slab_large, event)) {
+        k_mem_slab_free(&event_slab_large, &event);
+        return;
+    }
+#endif /* IS_ENABLED(CONFIG_ZMK_EVENT_MANAGER_SLABS) */
+
+    k_free(event);
+}
+
+void zmk_event_manager_get_alloc_stats(struct zmk_event_manager_alloc_stats *stats) {
+    *stats = alloc_stats;
+}
+
+static inline uint8_t subscription_index(const struct zmk_event_subscription *ev_sub) {
+    return ev_sub - __event_subscriptions_start;
+}
+
 int zmk_event_manager_handle_from(zmk_event_t *event, uint8_t start_index) {
     int ret = 0;
-    uint8_t len = __event_subscriptions_end - __event_subscriptions_start;
-    for (int i = start_index; i < len; i++) {
-        struct zmk_event_subscription *ev_sub = __event_subscriptions_start + i;
-        if (ev_sub->event_type != event->event) {
-            continue;
-        }
+    const struct zmk_event_subscription *ev_sub = __event_subscriptions_start + start_index;
+    const struct zmk_event_subscription *end = event->event->subscriptions_end;
+    if (ev_sub < event->event->subscriptions_start) {
+        ev_sub = event->event->subscriptions_start;
+    }
+    zmk_event_trace_resumed(event);
+    for (; ev_sub < end; ev_sub++) {
+        uint32_t start_cycles = zmk_event_trace_now();
         ret = ev_sub->listener->callback(event);
+        zmk_event_trace_listener(ev_sub->listener, start_cycles);
         switch (ret) {
         case ZMK_EV_EVENT_BUBBLE:
             continue;
@@ -35,7 +136,8 @@ int zmk_event_manager_handle_from(zmk_event_t *event, uint8_t start_index) {
             goto release;
         case ZMK_EV_EVENT_CAPTURED:
             LOG_DBG("Listener captured the event");
-            event->last_listener_index = i;
+            event->last_listener_index = subscription_index(ev_sub);
+            zmk_event_trace_captured(event);
             // Listeners are expected to free events they capture
             return 0;
         default:
@@ -45,20 +147,37 @@ int zmk_event_manager_handle_from(zmk_event_t *event, uint8_t start_index) {
     }
 
 release:
-    k_free(event);
+    zmk_event_manager_free(event);
     return ret;
 }
 
-int zmk_event_manager_raise(zmk_event_t *event) { return zmk_event_manager_handle_from(event, 0); }
+static const struct zmk_event_subscription *
+find_subscription(const zmk_event_t *event, const struct zmk_listener *listener) {
+    for (const struct zmk_event_subscription *ev_sub = event->event->subscriptions_start;
+         ev_sub < event->event->subscriptions_end; ev_sub++) {
+        if (ev_sub->listener == listener) {
+            return ev_sub;
+        }
+    }
+    return NULL;
+}
+
+int zmk_event_manager_raise(zmk_event_t *event) {
+    if (event == NULL) {
+        return -ENOMEM;
+    }
+    return zmk_event_manager_handle_from(event,
+                                         subscription_index(event->event->subscriptions_start));
+}
 
 int zmk_event_manager_raise_after(zmk_event_t *event, const struct zmk_listener *listener) {
-    uint8_t len = __event_subscriptions_end - __event_subscriptions_start;
-    for (int i = 0; i < len; i++) {
-        struct zmk_event_subscription *ev_sub = __event_subscriptions_start + i;
+    if (event == NULL) {
+        return -ENOMEM;
+    }
 
-        if (ev_sub->event_type == event->event && ev_sub->listener == listener) {
-            return zmk_event_manager_handle_from(event, i + 1);
-        }
+    const struct zmk_event_subscription *ev_sub = find_subscription(event, listener);
+    if (ev_sub != NULL) {
+        return zmk_event_manager_handle_from(event, subscription_index(ev_sub) + 1);
     }
 
     LOG_WRN("Unable to find where to raise this after event");
@@ -67,13 +186,13 @@ int zmk_event_manager_raise_after(zmk_event_t *event, const struct zmk_listener
 }
 
 int zmk_event_manager_raise_at(zmk_event_t *event, const struct zmk_listener *listener) {
-    uint8_t len = __event_subscriptions_end - __event_subscriptions_start;
-    for (int i = 0; i < len; i++) {
-        struct zmk_event_subscription *ev_sub = __event_subscriptions_start + i;
+    if (event == NULL) {
+        return -ENOMEM;
+    }
 
-        if (ev_sub->event_type == event->event && ev_sub->listener == listener) {
-            return zmk_event_manager_handle_from(event, i);
-        }
+    const struct zmk_event_subscription *ev_sub = find_subscription(event, listener);
+    if (ev_sub != NULL) {
+        return zmk_event_manager_handle_from(event, subscription_index(ev_sub));
     }
 
     LOG_WRN("Unable to find where to raise this event");
@@ -0,0 +1,202 @@
+/*
+ * Copyright (c) 2020 The ZMK Contributors
+ *
+ * SPDX-License-Identifier: MIT
+ */
+
+#include <zephyr.h>
+#include <sys/util.h>
+#include <logging/log.h>
+
+LOG_MODULE_DECLARE(zmk, CONFIG_ZMK_LOG_LEVEL);
+
+#include <zmk/event_manager.h>
+#include <zmk/event_trace.h>
+
+extern struct zmk_event_subscription __event_subscriptions_start[];
+extern struct zmk_event_subscription __event_subscriptions_end[];
+
+static struct zmk_event_trace_histogram capture_histogram;
+static struct zmk_event_trace_histogram report_histogram;
+static struct zmk_event_trace_histogram delivery_histogram;
+static struct zmk_event_trace_histogram backlog_histogram;
+
+// Cycle count of the oldest key scan that has not been followed by a report yet.
+static uint32_t pending_scan_at;
+static bool scan_pending;
+
+// Scan timestamp of the report that is being sent, 0 if it did not complete a scan.
+static uint32_t report_scan_at;
+
+void zmk_event_trace_histogram_record(struct zmk_event_trace_histogram *histogram, uint32_t us) {
+    // Number of significant bits of the duration selects the bucket: 0 -> 0, 1 -> 1, 2-3 -> 2...
+    int bucket = us == 0 ? 0 : 32 - __builtin_clz(us);
+
+    histogram->buckets[MIN(bucket, ZMK_EVENT_TRACE_HISTOGRAM_BUCKETS - 1)]++;
+    histogram->count++;
+    histogram->total_us += us;
+    if (us > histogram->max_us) {
+        histogram->max_us = us;
+    }
+}
+
+static inline uint32_t cycles_since(uint32_t start_cycles) {
+    return k_cyc_to_us_floor32(k_cycle_get_32() - start_cycles);
+}
+
+void zmk_event_trace_listener(const struct zmk_listener *listener, uint32_t start_cycles) {
+    zmk_event_trace_histogram_record(listener->histogram, cycles_since(start_cycles));
+}
+
+void zmk_event_trace_captured(zmk_event_t *event) {
+    // Zero marks an event that isn't captured, so avoid it as a timestamp.
+    event->captured_at = k_cycle_get_32() | 1;
+}
+
+void zmk_event_trace_resumed(zmk_event_t *event) {
+    if (event->captured_at == 0) {
+        return;
+    }
+
+    zmk_event_trace_histogram_record(&capture_histogram, cycles_since(event->captured_at));
+    event->captured_at = 0;
+}
+
+void zmk_event_trace_scan() {
+    if (!scan_pending) {
+        pending_scan_at = k_cycle_get_32();
+        scan_pending = true;
+    }
+}
+
+void zmk_event_trace_report() {
+    if (!scan_pending) {
+        report_scan_at = 0;
+        return;
+    }
+
+    zmk_event_trace_histogram_record(&report_histogram, cycles_since(pending_scan_at));
+    // Zero marks a report without a scan, so avoid it as a timestamp.
+    report_scan_at = pending_scan_at | 1;
+    scan_pending = false;
+}
+
+void zmk_event_trace_report_skipped() {
+    scan_pending = false;
+    report_scan_at = 0;
+}
+
+uint32_t zmk_event_trace_report_scan() { return report_scan_at; }
+
+void zmk_event_trace_delivered(uint32_t scan_at) {
+    if (scan_at == 0) {
+        return;
+    }
+
+    zmk_event_trace_histogram_record(&delivery_histogram, cycles_since(scan_at));
+}
+
+void zmk_event_trace_backlog(uint32_t queued_at) {
+    zmk_event_trace_histogram_record(&backlog_histogram, cycles_since(queued_at));
+}
+
+const struct zmk_event_trace_histogram *
+zmk_event_trace_listener_histogram(const struct zmk_listener *listener) {
+    return listener->histogram;
+}
+
+const struct zmk_event_trace_histogram *zmk_event_trace_capture_histogram() {
+    return &capture_histogram;
+}
+
+const struct zmk_event_trace_histogram *zmk_event_trace_report_histogram() {
+    return &report_histogram;
+}
+
+const struct zmk_event_trace_histogram *zmk_event_trace_delivery_histogram() {
+    return &delivery_histogram;
+}
+
+const struct zmk_event_trace_histogram *zmk_event_trace_backlog_histogram() {
+    return &backlog_histogram;
+}
+
+// A listener subscribed to several event types shows up several times in the subscriptions.
+static bool is_first_subscription_of_listener(const struct zmk_event_subscription *ev_sub) {
+    for (const struct zmk_event_subscription *prev = __event_subscriptions_start; prev < ev_sub;
+         prev++) {
+        if (prev->listener == ev_sub->listener) {
+            return false;
+        }
+    }
+    return true;
+}
+
+void zmk_event_trace_reset() {
+    for (const struct zmk_event_subscription *ev_sub = __event_subscriptions_start;
+         ev_sub < __event_subscriptions_end; ev_sub++) {
+        memset(ev_sub->listener->histogram, 0, sizeof(struct zmk_event_trace_histogram));
+    }
+    memset(&capture_histogram, 0, sizeof(capture_histogram));
+    memset(&report_histogram, 0, sizeof(report_histogram));
+    memset(&delivery_histogram, 0, sizeof(delivery_histogram));
+    memset(&backlog_histogram, 0, sizeof(backlog_histogram));
+    scan_pending = false;
+    report_scan_at = 0;
+}
+
+static void dump_histogram(const char *name, const struct zmk_event_trace_histogram *histogram) {
+    if (histogram->count == 0) {
+        return;
+    }
+
+    LOG_INF("%s: count %u max %uus avg %uus", log_strdup(name), histogram->count,
+            histogram->max_us, (uint32_t)(histogram->total_us / histogram->count));
+    for (int i = 0; i < ZMK_EVENT_TRACE_HISTOGRAM_BUCKETS; i++) {
+        if (histogram->buckets[i] == 0) {
+            continue;
+        }
+        if (i == ZMK_EVENT_TRACE_HISTOGRAM_BUCKETS - 1) {
+            LOG_INF("%s: >=%uus %u", log_strdup(name), (uint32_t)BIT(i - 1),
+                    histogram->buckets[i]);
+        } else {
+            LOG_INF("%s: <%uus %u", log_strdup(name), (uint32_t)BIT(i), histogram->buckets[i]);
+        }
+    }
+}
+
+void zmk_event_trace_dump() {
+    for (const struct zmk_event_subscription *ev_sub = __event_subscriptions_start;
+         ev_sub < __event_subscriptions_end; ev_sub++) {
+        if (is_first_subscription_of_listener(ev_sub)) {
+            dump_histogram(ev_sub->listener->name, ev_sub->listener->histogram);
+        }
+    }
+    dump_histogram("capture", &capture_histogram);
+    dump_histogram("scan_to_report", &report_histogram);
+    dump_histogram("scan_to_host", &delivery_histogram);
+    dump_histogram("report_backlog", &backlog_histogram);
+}
+
+#if IS_ENABLED(CONFIG_SHELL)
+#include <shell/shell.h>
+
+static int cmd_trace_show(const struct shell *shell, size_t argc, char **argv) {
+    zmk_event_trace_dump();
+    return 0;
+}
+
+static int cmd_trace_reset(const struct shell *shell, size_t argc, char **argv) {
+    zmk_event_trace_reset();
+    return 0;
+}
+
+SHELL_STATIC_SUBCMD_SET_CREATE(sub_trace,
+                               SHELL_CMD(show, NULL, "Log event latency histograms",
+                                         cmd_trace_show),
+                               SHELL_CMD(reset, NULL, "Clear event latency histograms",
+                                         cmd_trace_reset),
+                               SHELL_SUBCMD_SET_END);
+
+SHELL_CMD_REGISTER(zmk_trace, &sub_trace, "ZMK event latency tracing", NULL);
+#endif /* IS_ENABLED(CONFIG_SHELL) */
@@ -0,0 +1,10 @@
+/*
+ * Copyright (c) 2020 The ZMK Contributors
+ *
+ * SPDX-License-Identifier: MIT
+ */
+
+#include <kernel.h>
+#include <zmk/events/rgb_underglow_state_changed.h>
+
+ZMK_EVENT_IMPL(zmk_rgb_underglow_state_changed);
\ No newline at end of file
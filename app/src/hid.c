@@ -15,6 +15,8 @@ static struct zmk_hid_keyboard_report keyboard_report = {
 
 static struct zmk_hid_consumer_report consumer_report = {.report_id = 2, .body = {.keys = {0}}};
 
+static struct zmk_hid_boot_report boot_report;
+
 // Keep track of how often a modifier was pressed.
 // Only release the modifier if the count is 0.
 static int explicit_modifier_counts[8] = {0, 0, 0, 0, 0, 0, 0, 0};
@@ -69,8 +71,30 @@ int zmk_hid_unregister_mods(zmk_mod_flags_t modifiers) {
     return 0;
 }
 
+#if IS_ENABLED(CONFIG_ZMK_HID_REPORT_TYPE_NKRO)
+
+static int select_keyboard_usage(zmk_key_t usage) {
+    if (usage > ZMK_HID_KEYBOARD_NKRO_MAX_USAGE) {
+        LOG_ERR("Keyboard usage 0x%02X out of range", usage);
+        return -EINVAL;
+    }
+    WRITE_BIT(keyboard_report.body.keys[usage / 8], usage % 8, true);
+    return 0;
+}
+
+static int deselect_keyboard_usage(zmk_key_t usage) {
+    if (usage > ZMK_HID_KEYBOARD_NKRO_MAX_USAGE) {
+        LOG_ERR("Keyboard usage 0x%02X out of range", usage);
+        return -EINVAL;
+    }
+    WRITE_BIT(keyboard_report.body.keys[usage / 8], usage % 8, false);
+    return 0;
+}
+
+#else
+
 #define TOGGLE_KEYBOARD(match, val)                                                                \
-    for (int idx = 0; idx < ZMK_HID_KEYBOARD_NKRO_SIZE; idx++) {                                   \
+    for (int idx = 0; idx < CONFIG_ZMK_HID_KEYBOARD_REPORT_SIZE; idx++) {                          \
         if (keyboard_report.body.keys[idx] != match) {                                             \
             continue;                                                                              \
         }                                                                                          \
@@ -80,6 +104,18 @@ int zmk_hid_unregister_mods(zmk_mod_flags_t modifiers) {
         }                                                                                          \
     }
 
+static int select_keyboard_usage(zmk_key_t usage) {
+    TOGGLE_KEYBOARD(0U, usage);
+    return 0;
+}
+
+static int deselect_keyboard_usage(zmk_key_t usage) {
+    TOGGLE_KEYBOARD(usage, 0U);
+    return 0;
+}
+
+#endif /* IS_ENABLED(CONFIG_ZMK_HID_REPORT_TYPE_NKRO) */
+
 #define TOGGLE_CONSUMER(match, val)                                                                \
     for (int idx = 0; idx < ZMK_HID_CONSUMER_NKRO_SIZE; idx++) {                                   \
         if (consumer_report.body.keys[idx] != match) {                                             \
@@ -105,16 +141,14 @@ int zmk_hid_keyboard_press(zmk_key_t code) {
     if (code >= HID_USAGE_KEY_KEYBOARD_LEFTCONTROL && code <= HID_USAGE_KEY_KEYBOARD_RIGHT_GUI) {
         return zmk_hid_register_mod(code - HID_USAGE_KEY_KEYBOARD_LEFTCONTROL);
     }
-    TOGGLE_KEYBOARD(0U, code);
-    return 0;
+    return select_keyboard_usage(code);
 };
 
 int zmk_hid_keyboard_release(zmk_key_t code) {
     if (code >= HID_USAGE_KEY_KEYBOARD_LEFTCONTROL && code <= HID_USAGE_KEY_KEYBOARD_RIGHT_GUI) {
         return zmk_hid_unregister_mod(code - HID_USAGE_KEY_KEYBOARD_LEFTCONTROL);
     }
-    TOGGLE_KEYBOARD(code, 0U);
-    return 0;
+    return deselect_keyboard_usage(code);
 };
 
 void zmk_hid_keyboard_clear() { memset(&keyboard_report.body, 0, sizeof(keyboard_report.body)); }
@@ -138,3 +172,41 @@ struct zmk_hid_keyboard_report *zmk_hid_get_keyboard_report() {
 struct zmk_hid_consumer_report *zmk_hid_get_consumer_report() {
     return &consumer_report;
 }
+
+static void add_boot_usage(zmk_key_t usage, int *count) {
+    if (*count < ZMK_HID_BOOT_KEYBOARD_SIZE) {
+        boot_report.keys[*count] = usage;
+    }
+    (*count)++;
+}
+
+struct zmk_hid_boot_report *zmk_hid_get_boot_report() {
+    int count = 0;
+
+    memset(&boot_report, 0, sizeof(boot_report));
+    boot_report.modifiers = keyboard_report.body.modifiers;
+
+#if IS_ENABLED(CONFIG_ZMK_HID_REPORT_TYPE_NKRO)
+    for (int idx = 0; idx < sizeof(keyboard_report.body.keys); idx++) {
+        uint8_t bits = keyboard_report.body.keys[idx];
+        while (bits) {
+            int bit = __builtin_ctz(bits);
+            bits &= ~BIT(bit);
+            add_boot_usage(idx * 8 + bit, &count);
+        }
+    }
+#else
+    for (int idx = 0; idx < CONFIG_ZMK_HID_KEYBOARD_REPORT_SIZE; idx++) {
+        if (keyboard_report.body.keys[idx] != 0) {
+            add_boot_usage(keyboard_report.body.keys[idx], &count);
+        }
+    }
+#endif
+
+    // Boot protocol hosts expect every key slot set to ErrorRollOver when too many keys are down.
+    if (count > ZMK_HID_BOOT_KEYBOARD_SIZE) {
+        memset(boot_report.keys, HID_USAGE_KEY_KEYBOARD_ERRORROLLOVER, sizeof(boot_report.keys));
+    }
+
+    return &boot_report;
+}
@@ -70,9 +70,21 @@ static int hid_listener_keycode_released(const struct zmk_keycode_state_changed
     return zmk_endpoints_send_report(ev->usage_page);
 }
 
+#if IS_ENABLED(CONFIG_ZMK_ENDPOINTS_COALESCE_REPORTS)
+static bool queued_state = false;
+#endif
+
 int hid_listener(const zmk_event_t *eh) {
     const struct zmk_keycode_state_changed *ev = as_zmk_keycode_state_changed(eh);
     if (ev) {
+#if IS_ENABLED(CONFIG_ZMK_ENDPOINTS_COALESCE_REPORTS)
+        // Only presses or only releases are merged into one report, so taps and rolls still
+        // reach the host in the order they happened.
+        if (ev->state != queued_state) {
+            zmk_endpoints_flush_reports();
+            queued_state = ev->state;
+        }
+#endif
         if (ev->state) {
             hid_listener_keycode_pressed(ev);
         } else {
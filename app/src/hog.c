@@ -17,6 +17,7 @@ LOG_MODULE_DECLARE(zmk, CONFIG_ZMK_LOG_LEVEL);
 #include <zmk/ble.h>
 #include <zmk/hog.h>
 #include <zmk/hid.h>
+#include <zmk/event_trace.h>
 
 enum {
     HIDS_REMOTE_WAKE = BIT(0),
@@ -161,104 +162,247 @@ K_THREAD_STACK_DEFINE(hog_q_stack, CONFIG_ZMK_BLE_THREAD_STACK_SIZE);
 
 struct k_work_q hog_work_q;
 
-K_MSGQ_DEFINE(zmk_hog_keyboard_msgq, sizeof(struct zmk_hid_keyboard_report_body),
-              CONFIG_ZMK_BLE_KEYBOARD_REPORT_QUEUE_SIZE, 4);
+#define HOG_MAX_REPORT_SIZE                                                                        \
+    MAX(sizeof(struct zmk_hid_keyboard_report_body), sizeof(struct zmk_hid_consumer_report_body))
 
-void send_keyboard_report_callback(struct k_work *work) {
-    struct zmk_hid_keyboard_report_body report;
+struct hog_report {
+    // When the oldest report merged into this one was queued, see zmk_event_trace_now().
+    uint32_t queued_at;
+    // See zmk_event_trace_report_scan().
+    uint32_t scan_at;
+    uint8_t body[HOG_MAX_REPORT_SIZE];
+};
 
-    while (k_msgq_get(&zmk_hog_keyboard_msgq, &report, K_NO_WAIT) == 0) {
-        struct bt_conn *conn = destination_connection();
-        if (conn == NULL) {
-            return;
-        }
+// Reports are sent in order, but while the link is busy consecutive reports that only press or
+// only release keys are merged into the latest one. A key that went down and up again always
+// leaves a report with it held behind in the queue, so taps are never lost entirely. When the
+// queue is full, the keys of the next report are added to the last queued one instead.
+struct hog_report_channel {
+    int attr_index;
+    size_t len;
+    size_t bitmap_len;
+    size_t usage_size;
+    struct k_work *work;
+    // Ring of reports waiting to be sent.
+    struct hog_report *queue;
+    size_t queue_size;
+    size_t queue_head;
+    size_t queue_len;
+    // Last report put in the queue, the pending report's direction is relative to it.
+    uint8_t queued_body[HOG_MAX_REPORT_SIZE];
+    // Newest report, not in the queue yet so later ones can still be merged into it.
+    struct hog_report pending;
+    bool has_pending;
+    // Positive if the pending report only presses keys, negative if it only releases them.
+    int pending_direction;
+    uint32_t overflows;
+};
 
-        struct bt_gatt_notify_params notify_params = {
-            .attr = &hog_svc.attrs[5],
-            .data = &report,
-            .len = sizeof(report),
-        };
+// Guards the pending reports and keeps them ordered with the queued ones.
+K_MUTEX_DEFINE(hog_reports_mutex);
 
-        int err = bt_gatt_notify_cb(conn, &notify_params);
-        if (err) {
-            LOG_ERR("Error notifying %d", err);
+// A free slot in the usage arrays of the report bodies, sized for the widest usage.
+static const uint8_t empty_usage[sizeof(uint16_t)] = {0};
+
+// Whether every key in subset is also in superset. The first bitmap_len bytes of a body are
+// bitmaps, the rest is an array of usages that keep their slot while they are pressed.
+static bool report_contains(const struct hog_report_channel *channel, const uint8_t *superset,
+                            const uint8_t *subset) {
+    for (size_t i = 0; i < channel->bitmap_len; i++) {
+        if (subset[i] & ~superset[i]) {
+            return false;
+        }
+    }
+    for (size_t i = channel->bitmap_len; i < channel->len; i += channel->usage_size) {
+        if (memcmp(&subset[i], &superset[i], channel->usage_size) != 0 &&
+            memcmp(&subset[i], empty_usage, channel->usage_size) != 0) {
+            return false;
         }
+    }
+    return true;
+}
 
-        bt_conn_unref(conn);
+// Positive if to only adds keys to from, negative if it only removes keys, 0 if it does both.
+static int direction_between(const struct hog_report_channel *channel, const uint8_t *from,
+                             const uint8_t *to) {
+    if (report_contains(channel, to, from)) {
+        return 1;
     }
+    return report_contains(channel, from, to) ? -1 : 0;
 }
 
-K_WORK_DEFINE(hog_keyboard_work, send_keyboard_report_callback);
+// Adds the keys of from to into. A usage keeps its slot if it is free in into, otherwise it
+// takes the first free one. Usages without a free slot are left out, like any rollover.
+static void merge_report(const struct hog_report_channel *channel, uint8_t *into,
+                         const uint8_t *from) {
+    for (size_t i = 0; i < channel->bitmap_len; i++) {
+        into[i] |= from[i];
+    }
+    for (size_t i = channel->bitmap_len; i < channel->len; i += channel->usage_size) {
+        if (memcmp(&from[i], empty_usage, channel->usage_size) == 0 ||
+            memcmp(&into[i], &from[i], channel->usage_size) == 0) {
+            continue;
+        }
 
-int zmk_hog_send_keyboard_report(struct zmk_hid_keyboard_report_body *report) {
-    int err = k_msgq_put(&zmk_hog_keyboard_msgq, report, K_MSEC(100));
-    if (err) {
-        switch (err) {
-        case -EAGAIN: {
-            LOG_WRN("Keyboard message queue full, popping first message and queueing again");
-            struct zmk_hid_keyboard_report_body discarded_report;
-            k_msgq_get(&zmk_hog_keyboard_msgq, &discarded_report, K_NO_WAIT);
-            return zmk_hog_send_keyboard_report(report);
+        size_t slot = i;
+        if (memcmp(&into[slot], empty_usage, channel->usage_size) != 0) {
+            for (slot = channel->bitmap_len; slot < channel->len; slot += channel->usage_size) {
+                if (memcmp(&into[slot], &from[i], channel->usage_size) == 0 ||
+                    memcmp(&into[slot], empty_usage, channel->usage_size) == 0) {
+                    break;
+                }
+            }
         }
-        default:
-            LOG_WRN("Failed to queue keyboard report to send (%d)", err);
-            return err;
+        if (slot < channel->len) {
+            memcpy(&into[slot], &from[i], channel->usage_size);
         }
     }
+}
 
-    k_work_submit_to_queue(&hog_work_q, &hog_keyboard_work);
+static void queue_pending_report(struct hog_report_channel *channel) {
+    if (channel->queue_len < channel->queue_size) {
+        channel->queue[(channel->queue_head + channel->queue_len) % channel->queue_size] =
+            channel->pending;
+        channel->queue_len++;
+        memcpy(channel->queued_body, channel->pending.body, channel->len);
+    } else {
+        // Dropping a queued report could lose the only report a key was held in, so the keys of
+        // the pending report are added to the last queued one instead. The reports after it
+        // always carry the current state and release them.
+        struct hog_report *tail =
+            &channel->queue[(channel->queue_head + channel->queue_len - 1) % channel->queue_size];
+        channel->overflows++;
+        LOG_WRN("HOG report queue full (%d overflows so far), merging into the last report",
+                channel->overflows);
+        merge_report(channel, tail->body, channel->pending.body);
+        if (tail->scan_at == 0) {
+            tail->scan_at = channel->pending.scan_at;
+        }
+        memcpy(channel->queued_body, tail->body, channel->len);
+    }
+    channel->has_pending = false;
+}
 
+static int queue_report(struct hog_report_channel *channel, const void *body) {
+    k_mutex_lock(&hog_reports_mutex, K_FOREVER);
+
+    if (channel->has_pending) {
+        int direction = direction_between(channel, channel->pending.body, body);
+        if (direction != 0 && direction == channel->pending_direction) {
+            memcpy(channel->pending.body, body, channel->len);
+            if (channel->pending.scan_at == 0) {
+                channel->pending.scan_at = zmk_event_trace_report_scan();
+            }
+            k_mutex_unlock(&hog_reports_mutex);
+            return 0;
+        }
+
+        queue_pending_report(channel);
+    }
+
+    channel->pending.queued_at = zmk_event_trace_now();
+    channel->pending.scan_at = zmk_event_trace_report_scan();
+    memcpy(channel->pending.body, body, channel->len);
+    channel->pending_direction = direction_between(channel, channel->queued_body, body);
+    channel->has_pending = true;
+
+    k_mutex_unlock(&hog_reports_mutex);
+
+    k_work_submit_to_queue(&hog_work_q, channel->work);
     return 0;
-};
+}
+
+static bool take_report(struct hog_report_channel *channel, struct hog_report *report) {
+    bool taken = true;
+
+    k_mutex_lock(&hog_reports_mutex, K_FOREVER);
+    if (channel->queue_len > 0) {
+        *report = channel->queue[channel->queue_head];
+        channel->queue_head = (channel->queue_head + 1) % channel->queue_size;
+        channel->queue_len--;
+    } else if (channel->has_pending) {
+        *report = channel->pending;
+        memcpy(channel->queued_body, channel->pending.body, channel->len);
+        channel->has_pending = false;
+    } else {
+        taken = false;
+    }
+    k_mutex_unlock(&hog_reports_mutex);
 
-K_MSGQ_DEFINE(zmk_hog_consumer_msgq, sizeof(struct zmk_hid_consumer_report_body),
-              CONFIG_ZMK_BLE_CONSUMER_REPORT_QUEUE_SIZE, 4);
+    return taken;
+}
+
+static void send_reports(struct hog_report_channel *channel) {
+    struct hog_report report;
 
-void send_consumer_report_callback(struct k_work *work) {
-    struct zmk_hid_consumer_report_body report;
+    while (take_report(channel, &report)) {
+        zmk_event_trace_backlog(report.queued_at);
 
-    while (k_msgq_get(&zmk_hog_consumer_msgq, &report, K_NO_WAIT) == 0) {
         struct bt_conn *conn = destination_connection();
         if (conn == NULL) {
             return;
         }
 
         struct bt_gatt_notify_params notify_params = {
-            .attr = &hog_svc.attrs[10],
-            .data = &report,
-            .len = sizeof(report),
+            .attr = &hog_svc.attrs[channel->attr_index],
+            .data = report.body,
+            .len = channel->len,
         };
 
         int err = bt_gatt_notify_cb(conn, &notify_params);
         if (err) {
-            LOG_DBG("Error notifying %d", err);
+            LOG_ERR("Error notifying %d", err);
+        } else {
+            zmk_event_trace_delivered(report.scan_at);
         }
 
         bt_conn_unref(conn);
     }
-};
+}
+
+void send_keyboard_report_callback(struct k_work *work);
+void send_consumer_report_callback(struct k_work *work);
 
+K_WORK_DEFINE(hog_keyboard_work, send_keyboard_report_callback);
 K_WORK_DEFINE(hog_consumer_work, send_consumer_report_callback);
 
-int zmk_hog_send_consumer_report(struct zmk_hid_consumer_report_body *report) {
-    int err = k_msgq_put(&zmk_hog_consumer_msgq, report, K_MSEC(100));
-    if (err) {
-        switch (err) {
-        case -EAGAIN: {
-            LOG_WRN("Consumer message queue full, popping first message and queueing again");
-            struct zmk_hid_consumer_report_body discarded_report;
-            k_msgq_get(&zmk_hog_consumer_msgq, &discarded_report, K_NO_WAIT);
-            return zmk_hog_send_consumer_report(report);
-        }
-        default:
-            LOG_WRN("Failed to queue consumer report to send (%d)", err);
-            return err;
-        }
-    }
+static struct hog_report keyboard_queue[CONFIG_ZMK_BLE_KEYBOARD_REPORT_QUEUE_SIZE];
+static struct hog_report consumer_queue[CONFIG_ZMK_BLE_CONSUMER_REPORT_QUEUE_SIZE];
+
+static struct hog_report_channel keyboard_channel = {
+    .attr_index = 5,
+    .len = sizeof(struct zmk_hid_keyboard_report_body),
+#if IS_ENABLED(CONFIG_ZMK_HID_REPORT_TYPE_NKRO)
+    .bitmap_len = sizeof(struct zmk_hid_keyboard_report_body),
+#else
+    .bitmap_len = offsetof(struct zmk_hid_keyboard_report_body, keys),
+#endif
+    .usage_size = sizeof(uint8_t),
+    .queue = keyboard_queue,
+    .queue_size = ARRAY_SIZE(keyboard_queue),
+    .work = &hog_keyboard_work,
+};
 
-    k_work_submit_to_queue(&hog_work_q, &hog_consumer_work);
+static struct hog_report_channel consumer_channel = {
+    .attr_index = 10,
+    .len = sizeof(struct zmk_hid_consumer_report_body),
+    .bitmap_len = 0,
+    .usage_size = sizeof(uint16_t),
+    .queue = consumer_queue,
+    .queue_size = ARRAY_SIZE(consumer_queue),
+    .work = &hog_consumer_work,
+};
 
-    return 0;
+void send_keyboard_report_callback(struct k_work *work) { send_reports(&keyboard_channel); }
+
+void send_consumer_report_callback(struct k_work *work) { send_reports(&consumer_channel); }
+
+int zmk_hog_send_keyboard_report(struct zmk_hid_keyboard_report_body *report) {
+    return queue_report(&keyboard_channel, report);
+};
+
+int zmk_hog_send_consumer_report(struct zmk_hid_consumer_report_body *report) {
+    return queue_report(&consumer_channel, report);
 };
 
 int zmk_hog_init(const struct device *_arg) {
@@ -5,6 +5,7 @@
  */
 
 #include <sys/util.h>
+#include <init.h>
 #include <logging/log.h>
 LOG_MODULE_DECLARE(zmk, CONFIG_ZMK_LOG_LEVEL);
 
@@ -51,6 +52,9 @@ static uint8_t _zmk_keymap_layer_default = 0;
 
 #endif /* ZMK_KEYMAP_HAS_SENSORS */
 
+BUILD_ASSERT(ZMK_KEYMAP_LAYERS_LEN <= sizeof(zmk_keymap_layers_state_t) * 8,
+             "Too many keymap layers for zmk_keymap_layers_state_t");
+
 #define LAYER_LABEL(node) COND_CODE_0(DT_NODE_HAS_PROP(node, label), (NULL), (DT_LABEL(node))),
 
 // State
@@ -58,7 +62,7 @@ static uint8_t _zmk_keymap_layer_default = 0;
 // When a behavior handles a key position "down" event, we record the layer state
 // here so that even if that layer is deactivated before the "up", event, we
 // still send the release event to the behavior in that layer also.
-static uint32_t zmk_keymap_active_behavior_layer[ZMK_KEYMAP_LEN];
+static zmk_keymap_layers_state_t zmk_keymap_active_behavior_layer[ZMK_KEYMAP_LEN];
 
 static struct zmk_behavior_binding zmk_keymap[ZMK_KEYMAP_LAYERS_LEN][ZMK_KEYMAP_LEN] = {
     DT_INST_FOREACH_CHILD(0, TRANSFORMED_LAYER)};
@@ -85,7 +89,11 @@ static inline int set_layer_state(uint8_t layer, bool state) {
     }
 
     zmk_keymap_layers_state_t old_state = _zmk_keymap_layer_state;
-    WRITE_BIT(_zmk_keymap_layer_state, layer, state);
+    if (state) {
+        _zmk_keymap_layer_state |= BIT64(layer);
+    } else {
+        _zmk_keymap_layer_state &= ~BIT64(layer);
+    }
     // Don't send state changes unless there was an actual change
     if (old_state != _zmk_keymap_layer_state) {
         LOG_DBG("layer_changed: layer %d state %d", layer, state);
@@ -95,6 +103,17 @@ static inline int set_layer_state(uint8_t layer, bool state) {
     return 0;
 }
 
+// Highest layer set in the given state, which must not be empty.
+static inline uint8_t highest_layer(zmk_keymap_layers_state_t state) {
+    return sizeof(state) * 8 - 1 - __builtin_clzll(state);
+}
+
+// Layers to try when resolving a binding, i.e. the default layer and the active layers above it.
+static inline zmk_keymap_layers_state_t resolution_layers(zmk_keymap_layers_state_t state) {
+    zmk_keymap_layers_state_t default_layer = BIT64(_zmk_keymap_layer_default);
+    return (state | default_layer) & ~(default_layer - 1);
+}
+
 uint8_t zmk_keymap_layer_default() { return _zmk_keymap_layer_default; }
 
 zmk_keymap_layers_state_t zmk_keymap_layer_state() { return _zmk_keymap_layer_state; }
@@ -102,7 +121,7 @@ zmk_keymap_layers_state_t zmk_keymap_layer_state() { return _zmk_keymap_layer_st
 bool zmk_keymap_layer_active_with_state(uint8_t layer, zmk_keymap_layers_state_t state_to_test) {
     // The default layer is assumed to be ALWAYS ACTIVE so we include an || here to ensure nobody
     // breaks up that assumption by accident
-    return (state_to_test & (BIT(layer))) == (BIT(layer)) || layer == _zmk_keymap_layer_default;
+    return (state_to_test & (BIT64(layer))) == (BIT64(layer)) || layer == _zmk_keymap_layer_default;
 };
 
 bool zmk_keymap_layer_active(uint8_t layer) {
@@ -110,12 +129,7 @@ bool zmk_keymap_layer_active(uint8_t layer) {
 };
 
 uint8_t zmk_keymap_highest_layer_active() {
-    for (uint8_t layer = ZMK_KEYMAP_LAYERS_LEN - 1; layer > 0; layer--) {
-        if (zmk_keymap_layer_active(layer)) {
-            return layer;
-        }
-    }
-    return zmk_keymap_layer_default();
+    return highest_layer(_zmk_keymap_layer_state | BIT64(_zmk_keymap_layer_default));
 }
 
 int zmk_keymap_layer_activate(uint8_t layer) { return set_layer_state(layer, true); };
@@ -141,7 +155,7 @@ int zmk_keymap_layer_to(uint8_t layer) {
 }
 
 bool is_active_layer(uint8_t layer, zmk_keymap_layers_state_t layer_state) {
-    return (layer_state & BIT(layer)) == BIT(layer) || layer == _zmk_keymap_layer_default;
+    return (layer_state & BIT64(layer)) == BIT64(layer) || layer == _zmk_keymap_layer_default;
 }
 
 const char *zmk_keymap_layer_label(uint8_t layer) {
@@ -153,10 +167,10 @@ const char *zmk_keymap_layer_label(uint8_t layer) {
 }
 
 int zmk_keymap_apply_position_state(int layer, uint32_t position, bool pressed, int64_t timestamp) {
+    const struct device *behavior = zmk_behavior_binding_device(&zmk_keymap[layer][position]);
     // We want to make a copy of this, since it may be converted from
     // relative to absolute before being invoked
     struct zmk_behavior_binding binding = zmk_keymap[layer][position];
-    const struct device *behavior;
     struct zmk_behavior_binding_event event = {
         .layer = layer,
         .position = position,
@@ -166,8 +180,6 @@ int zmk_keymap_apply_position_state(int layer, uint32_t position, bool pressed,
     LOG_DBG("layer: %d position: %d, binding name: %s", layer, position,
             log_strdup(binding.behavior_dev));
 
-    behavior = device_get_binding(binding.behavior_dev);
-
     if (!behavior) {
         LOG_DBG("No behavior assigned to %d on layer %d", position, layer);
         return 1;
@@ -190,18 +202,21 @@ int zmk_keymap_position_state_changed(uint32_t position, bool pressed, int64_t t
     if (pressed) {
         zmk_keymap_active_behavior_layer[position] = _zmk_keymap_layer_state;
     }
-    for (int layer = ZMK_KEYMAP_LAYERS_LEN - 1; layer >= _zmk_keymap_layer_default; layer--) {
-        if (zmk_keymap_layer_active_with_state(layer, zmk_keymap_active_behavior_layer[position])) {
-            int ret = zmk_keymap_apply_position_state(layer, position, pressed, timestamp);
-            if (ret > 0) {
-                LOG_DBG("behavior processing to continue to next layer");
-                continue;
-            } else if (ret < 0) {
-                LOG_DBG("Behavior returned error: %d", ret);
-                return ret;
-            } else {
-                return ret;
-            }
+    zmk_keymap_layers_state_t layers =
+        resolution_layers(zmk_keymap_active_behavior_layer[position]);
+    while (layers) {
+        uint8_t layer = highest_layer(layers);
+        layers &= ~BIT64(layer);
+
+        int ret = zmk_keymap_apply_position_state(layer, position, pressed, timestamp);
+        if (ret > 0) {
+            LOG_DBG("behavior processing to continue to next layer");
+            continue;
+        } else if (ret < 0) {
+            LOG_DBG("Behavior returned error: %d", ret);
+            return ret;
+        } else {
+            return ret;
         }
     }
 
@@ -211,8 +226,12 @@ int zmk_keymap_position_state_changed(uint32_t position, bool pressed, int64_t t
 #if ZMK_KEYMAP_HAS_SENSORS
 int zmk_keymap_sensor_triggered(uint8_t sensor_number, const struct device *sensor,
                                 int64_t timestamp) {
-    for (int layer = ZMK_KEYMAP_LAYERS_LEN - 1; layer >= _zmk_keymap_layer_default; layer--) {
-        if (zmk_keymap_layer_active(layer) && zmk_sensor_keymap[layer] != NULL) {
+    zmk_keymap_layers_state_t layers = resolution_layers(_zmk_keymap_layer_state);
+    while (layers) {
+        uint8_t layer = highest_layer(layers);
+        layers &= ~BIT64(layer);
+
+        if (zmk_sensor_keymap[layer] != NULL) {
             struct zmk_behavior_binding *binding = &zmk_sensor_keymap[layer][sensor_number];
             const struct device *behavior;
             int ret;
@@ -220,7 +239,7 @@ int zmk_keymap_sensor_triggered(uint8_t sensor_number, const struct device *sens
             LOG_DBG("layer: %d sensor_number: %d, binding name: %s", layer, sensor_number,
                     log_strdup(binding->behavior_dev));
 
-            behavior = device_get_binding(binding->behavior_dev);
+            behavior = zmk_behavior_binding_device(binding);
 
             if (!behavior) {
                 LOG_DBG("No behavior assigned to %d on layer %d", sensor_number, layer);
@@ -270,3 +289,22 @@ ZMK_SUBSCRIPTION(keymap, zmk_position_state_changed);
 #if ZMK_KEYMAP_HAS_SENSORS
 ZMK_SUBSCRIPTION(keymap, zmk_sensor_event);
 #endif /* ZMK_KEYMAP_HAS_SENSORS */
+
+static int zmk_keymap_init(const struct device *_arg) {
+    // Resolve all behavior devices up front, so key events don't have to look them up by label.
+    // This runs after the behaviors themselves have been initialized.
+    for (int layer = 0; layer < ZMK_KEYMAP_LAYERS_LEN; layer++) {
+        for (int position = 0; position < ZMK_KEYMAP_LEN; position++) {
+            zmk_behavior_binding_device(&zmk_keymap[layer][position]);
+        }
+#if ZMK_KEYMAP_HAS_SENSORS
+        for (int sensor = 0; sensor < ZMK_KEYMAP_SENSORS_LEN; sensor++) {
+            zmk_behavior_binding_device(&zmk_sensor_keymap[layer][sensor]);
+        }
+#endif /* ZMK_KEYMAP_HAS_SENSORS */
+    }
+
+    return 0;
+}
+
+SYS_INIT(zmk_keymap_init, APPLICATION, CONFIG_APPLICATION_INIT_PRIORITY);
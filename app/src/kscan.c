@@ -11,8 +11,10 @@
 
 LOG_MODULE_DECLARE(zmk, CONFIG_ZMK_LOG_LEVEL);
 
+#include <zmk/matrix.h>
 #include <zmk/matrix_transform.h>
 #include <zmk/event_manager.h>
+#include <zmk/event_trace.h>
 #include <zmk/events/position_state_changed.h>
 
 #define ZMK_KSCAN_EVENT_STATE_PRESSED 0
@@ -22,35 +24,126 @@ struct zmk_kscan_event {
     uint32_t row;
     uint32_t column;
     uint32_t state;
+    // Uptime in ticks when the driver reported the change, so queueing doesn't delay it.
+    int64_t scanned_at;
 };
 
 struct zmk_kscan_msg_processor {
     struct k_work work;
 } msg_processor;
 
-K_MSGQ_DEFINE(zmk_kscan_msgq, sizeof(struct zmk_kscan_event), CONFIG_ZMK_KSCAN_EVENT_QUEUE_SIZE, 4);
+#define KSCAN_STATE_LEN (ZMK_MATRIX_ROWS * ZMK_MATRIX_COLS)
+#define KSCAN_STATE_WORDS ceiling_fraction(KSCAN_STATE_LEN, 32)
+
+// Room for every key of the matrix to change in a single scan.
+#define KSCAN_EVENT_QUEUE_SIZE MAX(CONFIG_ZMK_KSCAN_EVENT_QUEUE_SIZE, KSCAN_STATE_LEN)
+
+K_MSGQ_DEFINE(zmk_kscan_msgq, sizeof(struct zmk_kscan_event), KSCAN_EVENT_QUEUE_SIZE, 4);
+
+// Guards reported_state, reported_state_dirty and zmk_kscan_msgq as a unit. When the queue
+// overflows, the matrix state reported by the driver replaces the queued events, so the keymap
+// always ends up in the state of the matrix even if some edges were lost.
+static struct k_spinlock reported_state_lock;
+static uint32_t reported_state[KSCAN_STATE_WORDS];
+static bool reported_state_dirty;
+// Scan time of the last change included in the dirty state.
+static int64_t reported_state_scanned_at;
+
+// The matrix state raised as position events, only used by the work item.
+static uint32_t raised_state[KSCAN_STATE_WORDS];
+
+static uint32_t kscan_event_overflows = 0;
 
 static void zmk_kscan_callback(const struct device *dev, uint32_t row, uint32_t column,
                                bool pressed) {
+    if (row >= ZMK_MATRIX_ROWS || column >= ZMK_MATRIX_COLS) {
+        LOG_ERR("Invalid row %d or column %d", row, column);
+        return;
+    }
+
     struct zmk_kscan_event ev = {
         .row = row,
         .column = column,
-        .state = (pressed ? ZMK_KSCAN_EVENT_STATE_PRESSED : ZMK_KSCAN_EVENT_STATE_RELEASED)};
+        .state = (pressed ? ZMK_KSCAN_EVENT_STATE_PRESSED : ZMK_KSCAN_EVENT_STATE_RELEASED),
+        .scanned_at = k_uptime_ticks()};
+    uint32_t index = row * ZMK_MATRIX_COLS + column;
+    bool overflowed = false;
+
+    zmk_event_trace_scan();
+
+    k_spinlock_key_t key = k_spin_lock(&reported_state_lock);
+    WRITE_BIT(reported_state[index / 32], index % 32, pressed);
+    if (reported_state_dirty) {
+        reported_state_scanned_at = ev.scanned_at;
+    } else if (k_msgq_put(&zmk_kscan_msgq, &ev, K_NO_WAIT) != 0) {
+        overflowed = true;
+        reported_state_dirty = true;
+        reported_state_scanned_at = ev.scanned_at;
+    }
+    k_spin_unlock(&reported_state_lock, key);
+
+    if (overflowed) {
+        kscan_event_overflows++;
+        LOG_WRN("KSCAN event queue full (%d overflows so far), using the matrix state",
+                kscan_event_overflows);
+    }
 
-    k_msgq_put(&zmk_kscan_msgq, &ev, K_NO_WAIT);
     k_work_submit(&msg_processor.work);
 }
 
+static void raise_position_state_changed(uint32_t row, uint32_t column, bool pressed,
+                                         int64_t scanned_at) {
+    uint32_t index = row * ZMK_MATRIX_COLS + column;
+    uint32_t position = zmk_matrix_transform_row_column_to_position(row, column);
+    int64_t timestamp = k_ticks_to_ms_floor64(scanned_at);
+
+    WRITE_BIT(raised_state[index / 32], index % 32, pressed);
+
+    LOG_DBG("Row: %d, col: %d, position: %d, pressed: %s", row, column, position,
+            (pressed ? "true" : "false"));
+    ZMK_EVENT_RAISE(new_zmk_position_state_changed((struct zmk_position_state_changed){
+        .state = pressed, .position = position, .timestamp = timestamp}));
+}
+
+static void apply_reported_state(const uint32_t *state, int64_t scanned_at) {
+    // Release keys before pressing new ones, the order of the lost events is unknown anyway.
+    for (int pressed = 0; pressed <= 1; pressed++) {
+        for (int word = 0; word < KSCAN_STATE_WORDS; word++) {
+            uint32_t changed = state[word] ^ raised_state[word];
+            changed &= pressed ? state[word] : ~state[word];
+            for (; changed; changed &= changed - 1) {
+                uint32_t index = word * 32 + __builtin_ctz(changed);
+                raise_position_state_changed(index / ZMK_MATRIX_COLS, index % ZMK_MATRIX_COLS,
+                                             pressed, scanned_at);
+            }
+        }
+    }
+}
+
 void zmk_kscan_process_msgq(struct k_work *item) {
     struct zmk_kscan_event ev;
 
     while (k_msgq_get(&zmk_kscan_msgq, &ev, K_NO_WAIT) == 0) {
         bool pressed = (ev.state == ZMK_KSCAN_EVENT_STATE_PRESSED);
-        uint32_t position = zmk_matrix_transform_row_column_to_position(ev.row, ev.column);
-        LOG_DBG("Row: %d, col: %d, position: %d, pressed: %s", ev.row, ev.column, position,
-                (pressed ? "true" : "false"));
-        ZMK_EVENT_RAISE(new_zmk_position_state_changed((struct zmk_position_state_changed){
-            .state = pressed, .position = position, .timestamp = k_uptime_get()}));
+        raise_position_state_changed(ev.row, ev.column, pressed, ev.scanned_at);
+    }
+
+    uint32_t state[KSCAN_STATE_WORDS];
+    int64_t scanned_at;
+
+    k_spinlock_key_t key = k_spin_lock(&reported_state_lock);
+    bool dirty = reported_state_dirty;
+    if (dirty) {
+        reported_state_dirty = false;
+        // Anything queued since the loop above is included in the state.
+        k_msgq_purge(&zmk_kscan_msgq);
+        memcpy(state, reported_state, sizeof(state));
+        scanned_at = reported_state_scanned_at;
+    }
+    k_spin_unlock(&reported_state_lock, key);
+
+    if (dirty) {
+        apply_reported_state(state, scanned_at);
     }
 }
 
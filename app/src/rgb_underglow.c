@@ -18,6 +18,8 @@
 #include <drivers/ext_power.h>
 
 #include <zmk/rgb_underglow.h>
+#include <zmk/event_manager.h>
+#include <zmk/events/rgb_underglow_state_changed.h>
 
 LOG_MODULE_DECLARE(zmk, CONFIG_ZMK_LOG_LEVEL);
 
@@ -36,19 +38,11 @@ enum rgb_underglow_effect {
     UNDERGLOW_EFFECT_NUMBER // Used to track number of underglow effects
 };
 
-struct rgb_underglow_state {
-    struct zmk_led_hsb color;
-    uint8_t animation_speed;
-    uint8_t current_effect;
-    uint16_t animation_step;
-    bool on;
-};
-
 static const struct device *led_strip;
 
 static struct led_rgb pixels[STRIP_NUM_PIXELS];
 
-static struct rgb_underglow_state state;
+static struct zmk_rgb_underglow_state state;
 
 #if IS_ENABLED(CONFIG_ZMK_RGB_UNDERGLOW_EXT_POWER)
 static const struct device *ext_power;
@@ -225,7 +219,7 @@ static int zmk_rgb_underglow_init(const struct device *_arg) {
     }
 #endif
 
-    state = (struct rgb_underglow_state){
+    state = (struct zmk_rgb_underglow_state){
         color : {
             h : CONFIG_ZMK_RGB_UNDERGLOW_HUE_START,
             s : CONFIG_ZMK_RGB_UNDERGLOW_SAT_START,
@@ -256,7 +250,15 @@ static int zmk_rgb_underglow_init(const struct device *_arg) {
     return 0;
 }
 
+static int raise_state_changed() {
+    return ZMK_EVENT_RAISE(new_zmk_rgb_underglow_state_changed(
+        (struct zmk_rgb_underglow_state_changed){.state = state}));
+}
+
+// Called after every change, the state is announced right away and saved once it settled.
 int zmk_rgb_underglow_save_state() {
+    raise_state_changed();
+
 #if IS_ENABLED(CONFIG_SETTINGS)
     k_delayed_work_cancel(&underglow_save_work);
     return k_delayed_work_submit(&underglow_save_work, K_MSEC(CONFIG_ZMK_SETTINGS_SAVE_DEBOUNCE));
@@ -273,10 +275,7 @@ int zmk_rgb_underglow_get_state(bool *on_off) {
     return 0;
 }
 
-int zmk_rgb_underglow_on() {
-    if (!led_strip)
-        return -ENODEV;
-
+static void underglow_on() {
 #if IS_ENABLED(CONFIG_ZMK_RGB_UNDERGLOW_EXT_POWER)
     if (ext_power != NULL) {
         int rc = ext_power_enable(ext_power);
@@ -289,14 +288,18 @@ int zmk_rgb_underglow_on() {
     state.on = true;
     state.animation_step = 0;
     k_timer_start(&underglow_tick, K_NO_WAIT, K_MSEC(50));
-
-    return zmk_rgb_underglow_save_state();
 }
 
-int zmk_rgb_underglow_off() {
+int zmk_rgb_underglow_on() {
     if (!led_strip)
         return -ENODEV;
 
+    underglow_on();
+
+    return zmk_rgb_underglow_save_state();
+}
+
+static void underglow_off() {
 #if IS_ENABLED(CONFIG_ZMK_RGB_UNDERGLOW_EXT_POWER)
     if (ext_power != NULL) {
         int rc = ext_power_disable(ext_power);
@@ -314,6 +317,13 @@ int zmk_rgb_underglow_off() {
 
     k_timer_stop(&underglow_tick);
     state.on = false;
+}
+
+int zmk_rgb_underglow_off() {
+    if (!led_strip)
+        return -ENODEV;
+
+    underglow_off();
 
     return zmk_rgb_underglow_save_state();
 }
@@ -341,9 +351,54 @@ int zmk_rgb_underglow_set_hsb(struct zmk_led_hsb color) {
 
     state.color = color;
 
+    return raise_state_changed();
+}
+
+int zmk_rgb_underglow_get_full_state(struct zmk_rgb_underglow_state *full_state) {
+    if (!led_strip)
+        return -ENODEV;
+
+    *full_state = state;
     return 0;
 }
 
+// Used by split peripherals to mirror the underglow of the central, animation step included.
+int zmk_rgb_underglow_set_full_state(const struct zmk_rgb_underglow_state *full_state) {
+    if (!led_strip)
+        return -ENODEV;
+
+    if (full_state->color.h > HUE_MAX || full_state->color.s > SAT_MAX ||
+        full_state->color.b > BRT_MAX || full_state->current_effect >= UNDERGLOW_EFFECT_NUMBER ||
+        full_state->animation_speed < 1 || full_state->animation_speed > 5) {
+        return -ENOTSUP;
+    }
+
+    struct zmk_rgb_underglow_state old_state = state;
+
+    if (full_state->on != state.on) {
+        if (full_state->on) {
+            underglow_on();
+        } else {
+            underglow_off();
+        }
+    }
+
+    state.color = full_state->color;
+    state.animation_speed = full_state->animation_speed;
+    state.current_effect = full_state->current_effect;
+    state.animation_step = full_state->animation_step;
+
+    // A new animation step alone is not worth a flash write. The fields are compared one by one,
+    // the padding of the struct is not initialized.
+    if (old_state.color.h == state.color.h && old_state.color.s == state.color.s &&
+        old_state.color.b == state.color.b && old_state.animation_speed == state.animation_speed &&
+        old_state.current_effect == state.current_effect && old_state.on == state.on) {
+        return 0;
+    }
+
+    return zmk_rgb_underglow_save_state();
+}
+
 struct zmk_led_hsb zmk_rgb_underglow_calc_hue(int direction) {
     struct zmk_led_hsb color = state.color;
 
@@ -18,40 +18,296 @@
 LOG_MODULE_DECLARE(zmk, CONFIG_ZMK_LOG_LEVEL);
 
 #include <zmk/ble.h>
+#include <zmk/matrix.h>
 #include <zmk/split/bluetooth/uuid.h>
-#include <zmk/event_manager.h>
-#include <zmk/events/position_state_changed.h>
+#include <zmk/split/bluetooth/protocol.h>
+#include <zmk/split/central.h>
+#include <zmk/split/clock.h>
 #include <init.h>
 
 static int start_scan(void);
 
-#define POSITION_STATE_DATA_LEN 16
+// Position events arriving while the full state is being read, applied once it arrived.
+#define RESYNC_BUFFER_LEN 32
+struct buffered_position_event {
+    struct zmk_split_bt_position_event event;
+    int64_t received_at;
+};
+
+enum peripheral_slot_state {
+    PERIPHERAL_SLOT_STATE_OPEN,
+    PERIPHERAL_SLOT_STATE_CONNECTING,
+    PERIPHERAL_SLOT_STATE_CONNECTED,
+};
+
+struct peripheral_slot {
+    enum peripheral_slot_state state;
+    struct bt_conn *conn;
+
+    struct bt_uuid_128 uuid;
+    struct bt_gatt_discover_params discover_params;
+    struct bt_gatt_subscribe_params subscribe_params;
+    struct bt_gatt_read_params read_params;
+
+    // Value handle of the full position state, read to resync after missed position events.
+    uint16_t position_state_handle;
+
+    // The keymap positions the central raised events for.
+    uint8_t position_state[ZMK_SPLIT_BT_POSITION_STATE_LEN];
+
+    // Added to the positions of the peripheral, part of the position state it reports.
+    uint32_t position_offset;
+
+    bool position_state_synced;
+    uint8_t next_sequence;
+
+    bool resyncing;
+    // The full state read so far, large keymaps take several ATT reads.
+    struct zmk_split_bt_position_state read_state;
+    uint16_t read_state_len;
+    struct buffered_position_event resync_buffer[RESYNC_BUFFER_LEN];
+    int resync_buffer_len;
+    bool resync_buffer_overflowed;
+
+    struct zmk_split_clock clock;
+
+    // The last timestamp raised for the peripheral, so its events never go back in time.
+    int64_t last_position_timestamp;
+
+    // Value handle the central state is written to, 0 for peripherals without one.
+    uint16_t central_state_handle;
+};
+
+// Slots are indexed like the peripheral addresses stored by zmk_ble_put_peripheral_addr().
+static struct peripheral_slot peripherals[CONFIG_ZMK_SPLIT_BLE_CENTRAL_PERIPHERALS];
+
+// The last central state, written to every peripheral once it is connected and encrypted.
+static struct zmk_split_central_state central_state;
+static bool central_state_set;
+
+static struct peripheral_slot *peripheral_slot_for_conn(struct bt_conn *conn) {
+    for (int i = 0; i < ARRAY_SIZE(peripherals); i++) {
+        if (peripherals[i].conn == conn) {
+            return &peripherals[i];
+        }
+    }
+
+    return NULL;
+}
+
+static int write_central_state(struct peripheral_slot *slot) {
+    if (!central_state_set || slot->state != PERIPHERAL_SLOT_STATE_CONNECTED ||
+        !slot->central_state_handle || bt_conn_get_security(slot->conn) < BT_SECURITY_L2) {
+        return 0;
+    }
+
+    return bt_gatt_write_without_response(slot->conn, slot->central_state_handle, &central_state,
+                                          sizeof(central_state), false);
+}
+
+int zmk_split_central_send_state(const struct zmk_split_central_state *state) {
+    int ret = 0;
+
+    central_state = *state;
+    central_state_set = true;
 
-static struct bt_conn *default_conn;
+    for (int i = 0; i < ARRAY_SIZE(peripherals); i++) {
+        int err = write_central_state(&peripherals[i]);
+        if (err) {
+            LOG_ERR("Failed to write the central state (err %d)", err);
+            ret = err;
+        }
+    }
+
+    return ret;
+}
 
-static struct bt_uuid_128 uuid = BT_UUID_INIT_128(ZMK_SPLIT_BT_SERVICE_UUID);
-static struct bt_gatt_discover_params discover_params;
-static struct bt_gatt_subscribe_params subscribe_params;
+static void raise_position_state_changed(struct peripheral_slot *slot, uint32_t position,
+                                         bool pressed, int64_t timestamp) {
+    WRITE_BIT(slot->position_state[position / 8], position % 8, pressed);
 
-K_MSGQ_DEFINE(peripheral_event_msgq, sizeof(struct zmk_position_state_changed),
-              CONFIG_ZMK_SPLIT_BLE_CENTRAL_POSITION_QUEUE_SIZE, 4);
+    slot->last_position_timestamp = MAX(timestamp, slot->last_position_timestamp);
 
-void peripheral_event_work_callback(struct k_work *work) {
-    struct zmk_position_state_changed ev;
-    while (k_msgq_get(&peripheral_event_msgq, &ev, K_NO_WAIT) == 0) {
-        LOG_DBG("Trigger key position state change for %d", ev.position);
-        ZMK_EVENT_RAISE(new_zmk_position_state_changed(ev));
+    zmk_split_central_position_state_changed(position, pressed, slot->last_position_timestamp);
+}
+
+static void release_peripheral_positions(struct peripheral_slot *slot) {
+    int64_t now = k_uptime_get();
+
+    for (uint32_t position = 0; position < ZMK_KEYMAP_LEN; position++) {
+        if (slot->position_state[position / 8] & BIT(position % 8)) {
+            raise_position_state_changed(slot, position, false, now);
+        }
     }
 }
 
-K_WORK_DEFINE(peripheral_event_work, peripheral_event_work_callback);
+static uint8_t split_central_resync_read_func(struct bt_conn *conn, uint8_t err,
+                                              struct bt_gatt_read_params *params,
+                                              const void *data, uint16_t length);
+
+static void start_resync(struct peripheral_slot *slot) {
+    if (slot->resyncing) {
+        return;
+    }
+
+    LOG_DBG("Reading full position state to resync");
+
+    slot->resyncing = true;
+    slot->read_state_len = 0;
+    slot->resync_buffer_len = 0;
+    slot->resync_buffer_overflowed = false;
+
+    slot->read_params.func = split_central_resync_read_func;
+    slot->read_params.handle_count = 1;
+    slot->read_params.single.handle = slot->position_state_handle;
+    slot->read_params.single.offset = 0;
+
+    int err = bt_gatt_read(slot->conn, &slot->read_params);
+    if (err) {
+        LOG_ERR("Failed to read position state (err %d)", err);
+        slot->resyncing = false;
+        slot->position_state_synced = false;
+    }
+}
+
+static void handle_position_event(struct peripheral_slot *slot,
+                                  const struct zmk_split_bt_position_event *event,
+                                  int64_t received_at) {
+    uint8_t sequence = event->sequence_state & ZMK_SPLIT_BT_EVENT_SEQUENCE_MASK;
+
+    if (slot->resyncing) {
+        if (slot->resync_buffer_len < RESYNC_BUFFER_LEN) {
+            slot->resync_buffer[slot->resync_buffer_len++] = (struct buffered_position_event){
+                .event = *event,
+                .received_at = received_at,
+            };
+        } else {
+            slot->resync_buffer_overflowed = true;
+        }
+        return;
+    }
+
+    if (sys_le16_to_cpu(event->position) == ZMK_SPLIT_BT_POSITION_SEQUENCE_HINT) {
+        // Carries the sequence number of the last event sent, so a dropped event is noticed
+        // without waiting for the next one.
+        if (!slot->position_state_synced ||
+            ((sequence + 1) & ZMK_SPLIT_BT_EVENT_SEQUENCE_MASK) != slot->next_sequence) {
+            LOG_WRN("Missed position events (expected %d, last sent %d)", slot->next_sequence,
+                    sequence);
+            start_resync(slot);
+        }
+        return;
+    }
+
+    if (!slot->position_state_synced || sequence != slot->next_sequence) {
+        if (slot->position_state_synced) {
+            LOG_WRN("Missed position events (expected %d got %d)", slot->next_sequence,
+                    sequence);
+        }
+        start_resync(slot);
+        if (slot->resyncing) {
+            handle_position_event(slot, event, received_at);
+        }
+        return;
+    }
+
+    slot->next_sequence = (sequence + 1) & ZMK_SPLIT_BT_EVENT_SEQUENCE_MASK;
+
+    uint32_t position = sys_le16_to_cpu(event->position) + slot->position_offset;
+    if (position >= ZMK_KEYMAP_LEN) {
+        LOG_ERR("Invalid position %d", position);
+        return;
+    }
+
+    raise_position_state_changed(
+        slot, position, event->sequence_state & ZMK_SPLIT_BT_EVENT_PRESSED,
+        zmk_split_clock_map(&slot->clock, sys_le16_to_cpu(event->timestamp), received_at));
+}
+
+static void apply_position_state(struct peripheral_slot *slot) {
+    const struct zmk_split_bt_position_state *state = &slot->read_state;
+    size_t positions_len =
+        slot->read_state_len - offsetof(struct zmk_split_bt_position_state, positions);
+    int64_t now = k_uptime_get();
+
+    slot->position_offset = sys_le16_to_cpu(state->position_offset);
+
+    // Release keys before pressing new ones, the order of the missed events is lost anyway.
+    for (int pressed = 0; pressed <= 1; pressed++) {
+        for (uint32_t i = 0; i < positions_len * 8; i++) {
+            uint32_t position = slot->position_offset + i;
+            if (position >= ZMK_KEYMAP_LEN) {
+                break;
+            }
+
+            bool was_pressed = slot->position_state[position / 8] & BIT(position % 8);
+            bool is_pressed = state->positions[i / 8] & BIT(i % 8);
+            if (is_pressed == pressed && was_pressed != pressed) {
+                raise_position_state_changed(slot, position, pressed, now);
+            }
+        }
+    }
+}
+
+static uint8_t split_central_resync_read_func(struct bt_conn *conn, uint8_t err,
+                                              struct bt_gatt_read_params *params,
+                                              const void *data, uint16_t length) {
+    struct peripheral_slot *slot = CONTAINER_OF(params, struct peripheral_slot, read_params);
+
+    if (!slot->resyncing) {
+        return BT_GATT_ITER_STOP;
+    }
+
+    // Called once per ATT read, and once more without data when the whole value was read.
+    if (!err && data) {
+        // Positions beyond the keymap of the central are dropped.
+        uint16_t copy_len = MIN(length, sizeof(slot->read_state) - slot->read_state_len);
+        memcpy((uint8_t *)&slot->read_state + slot->read_state_len, data, copy_len);
+        slot->read_state_len += copy_len;
+        return BT_GATT_ITER_CONTINUE;
+    }
+
+    slot->resyncing = false;
+
+    if (err || slot->read_state_len < offsetof(struct zmk_split_bt_position_state, positions)) {
+        LOG_ERR("Failed to read position state (err %d length %d)", err, slot->read_state_len);
+        slot->position_state_synced = false;
+        return BT_GATT_ITER_STOP;
+    }
+
+    apply_position_state(slot);
+
+    uint8_t state_sequence = slot->read_state.sequence;
+    slot->position_state_synced = true;
+    slot->next_sequence = (state_sequence + 1) & ZMK_SPLIT_BT_EVENT_SEQUENCE_MASK;
+
+    if (slot->resync_buffer_overflowed) {
+        start_resync(slot);
+        return BT_GATT_ITER_STOP;
+    }
+
+    // Handling the buffered events may start another resync, which reuses the buffer.
+    struct buffered_position_event buffered[RESYNC_BUFFER_LEN];
+    int buffered_len = slot->resync_buffer_len;
+    memcpy(buffered, slot->resync_buffer, buffered_len * sizeof(buffered[0]));
+
+    for (int i = 0; i < buffered_len; i++) {
+        // Skip events that are already part of the state that was read.
+        uint8_t age = (state_sequence - buffered[i].event.sequence_state) &
+                      ZMK_SPLIT_BT_EVENT_SEQUENCE_MASK;
+        if (age < (ZMK_SPLIT_BT_EVENT_SEQUENCE_MASK + 1) / 2) {
+            continue;
+        }
+        handle_position_event(slot, &buffered[i].event, buffered[i].received_at);
+    }
+
+    return BT_GATT_ITER_STOP;
+}
 
 static uint8_t split_central_notify_func(struct bt_conn *conn,
                                          struct bt_gatt_subscribe_params *params, const void *data,
                                          uint16_t length) {
-    static uint8_t position_state[POSITION_STATE_DATA_LEN];
-
-    uint8_t changed_positions[POSITION_STATE_DATA_LEN];
+    struct peripheral_slot *slot = CONTAINER_OF(params, struct peripheral_slot, subscribe_params);
 
     if (!data) {
         LOG_DBG("[UNSUBSCRIBED]");
@@ -61,30 +317,17 @@ static uint8_t split_central_notify_func(struct bt_conn *conn,
 
     LOG_DBG("[NOTIFICATION] data %p length %u", data, length);
 
-    for (int i = 0; i < POSITION_STATE_DATA_LEN; i++) {
-        changed_positions[i] = ((uint8_t *)data)[i] ^ position_state[i];
-        position_state[i] = ((uint8_t *)data)[i];
-    }
-
-    for (int i = 0; i < POSITION_STATE_DATA_LEN; i++) {
-        for (int j = 0; j < 8; j++) {
-            if (changed_positions[i] & BIT(j)) {
-                uint32_t position = (i * 8) + j;
-                bool pressed = position_state[i] & BIT(j);
-                struct zmk_position_state_changed ev = {
-                    .position = position, .state = pressed, .timestamp = k_uptime_get()};
-
-                k_msgq_put(&peripheral_event_msgq, &ev, K_NO_WAIT);
-                k_work_submit(&peripheral_event_work);
-            }
-        }
+    int64_t received_at = k_uptime_get();
+    const struct zmk_split_bt_position_event *events = data;
+    for (int i = 0; i < length / sizeof(struct zmk_split_bt_position_event); i++) {
+        handle_position_event(slot, &events[i], received_at);
     }
 
     return BT_GATT_ITER_CONTINUE;
 }
 
-static int split_central_subscribe(struct bt_conn *conn) {
-    int err = bt_gatt_subscribe(conn, &subscribe_params);
+static int split_central_subscribe(struct peripheral_slot *slot) {
+    int err = bt_gatt_subscribe(slot->conn, &slot->subscribe_params);
     switch (err) {
     case -EALREADY:
         LOG_DBG("[ALREADY SUBSCRIBED]");
@@ -105,6 +348,7 @@ static int split_central_subscribe(struct bt_conn *conn) {
 
 static uint8_t split_central_discovery_func(struct bt_conn *conn, const struct bt_gatt_attr *attr,
                                             struct bt_gatt_discover_params *params) {
+    struct peripheral_slot *slot = CONTAINER_OF(params, struct peripheral_slot, discover_params);
     int err;
 
     if (!attr) {
@@ -115,60 +359,97 @@ static uint8_t split_central_discovery_func(struct bt_conn *conn, const struct b
 
     LOG_DBG("[ATTRIBUTE] handle %u", attr->handle);
 
-    if (!bt_uuid_cmp(discover_params.uuid, BT_UUID_DECLARE_128(ZMK_SPLIT_BT_SERVICE_UUID))) {
-        memcpy(&uuid, BT_UUID_DECLARE_128(ZMK_SPLIT_BT_CHAR_POSITION_STATE_UUID), sizeof(uuid));
-        discover_params.uuid = &uuid.uuid;
-        discover_params.start_handle = attr->handle + 1;
-        discover_params.type = BT_GATT_DISCOVER_CHARACTERISTIC;
+    if (!bt_uuid_cmp(params->uuid, BT_UUID_DECLARE_128(ZMK_SPLIT_BT_SERVICE_UUID))) {
+        memcpy(&slot->uuid, BT_UUID_DECLARE_128(ZMK_SPLIT_BT_CHAR_POSITION_STATE_UUID),
+               sizeof(slot->uuid));
+        params->uuid = &slot->uuid.uuid;
+        params->start_handle = attr->handle + 1;
+        params->type = BT_GATT_DISCOVER_CHARACTERISTIC;
 
-        err = bt_gatt_discover(conn, &discover_params);
+        err = bt_gatt_discover(conn, params);
         if (err) {
             LOG_ERR("Discover failed (err %d)", err);
         }
-    } else if (!bt_uuid_cmp(discover_params.uuid,
+    } else if (!bt_uuid_cmp(params->uuid,
                             BT_UUID_DECLARE_128(ZMK_SPLIT_BT_CHAR_POSITION_STATE_UUID))) {
-        memcpy(&uuid, BT_UUID_GATT_CCC, sizeof(uuid));
-        discover_params.uuid = &uuid.uuid;
-        discover_params.start_handle = attr->handle + 2;
-        discover_params.type = BT_GATT_DISCOVER_DESCRIPTOR;
-        subscribe_params.value_handle = bt_gatt_attr_value_handle(attr);
+        slot->position_state_handle = bt_gatt_attr_value_handle(attr);
+
+        memcpy(&slot->uuid, BT_UUID_DECLARE_128(ZMK_SPLIT_BT_CHAR_POSITION_EVENTS_UUID),
+               sizeof(slot->uuid));
+        params->uuid = &slot->uuid.uuid;
+        params->start_handle = attr->handle + 1;
+        params->type = BT_GATT_DISCOVER_CHARACTERISTIC;
 
-        err = bt_gatt_discover(conn, &discover_params);
+        err = bt_gatt_discover(conn, params);
         if (err) {
             LOG_ERR("Discover failed (err %d)", err);
         }
-    } else {
-        subscribe_params.notify = split_central_notify_func;
-        subscribe_params.value = BT_GATT_CCC_NOTIFY;
-        subscribe_params.ccc_handle = attr->handle;
+    } else if (!bt_uuid_cmp(params->uuid,
+                            BT_UUID_DECLARE_128(ZMK_SPLIT_BT_CHAR_POSITION_EVENTS_UUID))) {
+        memcpy(&slot->uuid, BT_UUID_GATT_CCC, sizeof(slot->uuid));
+        params->uuid = &slot->uuid.uuid;
+        params->start_handle = attr->handle + 2;
+        params->type = BT_GATT_DISCOVER_DESCRIPTOR;
+        slot->subscribe_params.value_handle = bt_gatt_attr_value_handle(attr);
+
+        err = bt_gatt_discover(conn, params);
+        if (err) {
+            LOG_ERR("Discover failed (err %d)", err);
+        }
+    } else if (!bt_uuid_cmp(params->uuid, BT_UUID_GATT_CCC)) {
+        slot->subscribe_params.notify = split_central_notify_func;
+        slot->subscribe_params.value = BT_GATT_CCC_NOTIFY;
+        slot->subscribe_params.ccc_handle = attr->handle;
 
-        split_central_subscribe(conn);
+        split_central_subscribe(slot);
 
-        return BT_GATT_ITER_STOP;
+        // The sequence numbers of the peripheral are unknown until the full state was read.
+        slot->position_state_synced = false;
+        start_resync(slot);
+
+        // Peripherals of older releases end the discovery here.
+        memcpy(&slot->uuid, BT_UUID_DECLARE_128(ZMK_SPLIT_BT_CHAR_CENTRAL_STATE_UUID),
+               sizeof(slot->uuid));
+        params->uuid = &slot->uuid.uuid;
+        params->start_handle = attr->handle + 1;
+        params->type = BT_GATT_DISCOVER_CHARACTERISTIC;
+
+        err = bt_gatt_discover(conn, params);
+        if (err) {
+            LOG_ERR("Discover failed (err %d)", err);
+        }
+    } else {
+        slot->central_state_handle = bt_gatt_attr_value_handle(attr);
+
+        err = write_central_state(slot);
+        if (err) {
+            LOG_ERR("Failed to write the central state (err %d)", err);
+        }
     }
 
     return BT_GATT_ITER_STOP;
 }
 
-static void split_central_process_connection(struct bt_conn *conn) {
+static void split_central_process_connection(struct peripheral_slot *slot) {
     int err;
 
-    LOG_DBG("Current security for connection: %d", bt_conn_get_security(conn));
+    LOG_DBG("Current security for connection: %d", bt_conn_get_security(slot->conn));
 
-    err = bt_conn_set_security(conn, BT_SECURITY_L2);
+    err = bt_conn_set_security(slot->conn, BT_SECURITY_L2);
     if (err) {
         LOG_ERR("Failed to set security (reason %d)", err);
         return;
     }
 
-    if (conn == default_conn && !subscribe_params.value) {
-        discover_params.uuid = &uuid.uuid;
-        discover_params.func = split_central_discovery_func;
-        discover_params.start_handle = 0x0001;
-        discover_params.end_handle = 0xffff;
-        discover_params.type = BT_GATT_DISCOVER_PRIMARY;
+    if (!slot->subscribe_params.value) {
+        memcpy(&slot->uuid, BT_UUID_DECLARE_128(ZMK_SPLIT_BT_SERVICE_UUID), sizeof(slot->uuid));
+        slot->discover_params.uuid = &slot->uuid.uuid;
+        slot->discover_params.func = split_central_discovery_func;
+        slot->discover_params.start_handle = 0x0001;
+        slot->discover_params.end_handle = 0xffff;
+        slot->discover_params.type = BT_GATT_DISCOVER_PRIMARY;
 
-        err = bt_gatt_discover(default_conn, &discover_params);
+        err = bt_gatt_discover(slot->conn, &slot->discover_params);
         if (err) {
             LOG_ERR("Discover failed(err %d)", err);
             return;
@@ -177,7 +458,7 @@ static void split_central_process_connection(struct bt_conn *conn) {
 
     struct bt_conn_info info;
 
-    bt_conn_get_info(conn, &info);
+    bt_conn_get_info(slot->conn, &info);
 
     LOG_DBG("New connection params: Interval: %d, Latency: %d, PHY: %d", info.le.interval,
             info.le.latency, info.le.phy->rx_phy);
@@ -221,7 +502,16 @@ static bool split_central_eir_found(struct bt_data *data, void *user_data) {
 
             LOG_DBG("Found the split service");
 
-            zmk_ble_set_peripheral_addr(addr);
+            int slot_index = zmk_ble_put_peripheral_addr(addr);
+            if (slot_index < 0) {
+                LOG_WRN("Not connecting to an unknown peripheral, all slots are taken");
+                return false;
+            }
+
+            struct peripheral_slot *slot = &peripherals[slot_index];
+            if (slot->state != PERIPHERAL_SLOT_STATE_OPEN) {
+                return false;
+            }
 
             err = bt_le_scan_stop();
             if (err) {
@@ -229,24 +519,29 @@ static bool split_central_eir_found(struct bt_data *data, void *user_data) {
                 continue;
             }
 
-            default_conn = bt_conn_lookup_addr_le(BT_ID_DEFAULT, addr);
-            if (default_conn) {
+            slot->conn = bt_conn_lookup_addr_le(BT_ID_DEFAULT, addr);
+            if (slot->conn) {
                 LOG_DBG("Found existing connection");
-                split_central_process_connection(default_conn);
+                slot->state = PERIPHERAL_SLOT_STATE_CONNECTED;
+                split_central_process_connection(slot);
+                start_scan();
             } else {
                 param = BT_LE_CONN_PARAM(0x0006, 0x0006, 30, 400);
 
-                err = bt_conn_le_create(addr, BT_CONN_LE_CREATE_CONN, param, &default_conn);
+                err = bt_conn_le_create(addr, BT_CONN_LE_CREATE_CONN, param, &slot->conn);
                 if (err) {
                     LOG_ERR("Create conn failed (err %d) (create conn? 0x%04x)", err,
                             BT_HCI_OP_LE_CREATE_CONN);
+                    slot->conn = NULL;
                     start_scan();
+                    return false;
                 }
 
-                err = bt_conn_le_phy_update(default_conn, BT_CONN_LE_PHY_PARAM_2M);
+                slot->state = PERIPHERAL_SLOT_STATE_CONNECTING;
+
+                err = bt_conn_le_phy_update(slot->conn, BT_CONN_LE_PHY_PARAM_2M);
                 if (err) {
                     LOG_ERR("Update phy conn failed (err %d)", err);
-                    start_scan();
                 }
             }
 
@@ -271,10 +566,33 @@ static void split_central_device_found(const bt_addr_le_t *addr, int8_t rssi, ui
     }
 }
 
+// Scans while any peripheral is missing. Connections are created one at a time, so scanning
+// pauses while one is pending and resumes alongside the discovery of the new peripheral.
 static int start_scan(void) {
     int err;
+    bool has_open_slot = false;
+
+    for (int i = 0; i < ARRAY_SIZE(peripherals); i++) {
+        switch (peripherals[i].state) {
+        case PERIPHERAL_SLOT_STATE_CONNECTING:
+            return 0;
+        case PERIPHERAL_SLOT_STATE_OPEN:
+            has_open_slot = true;
+            break;
+        default:
+            break;
+        }
+    }
+
+    if (!has_open_slot) {
+        LOG_DBG("All peripherals are connected");
+        return 0;
+    }
 
     err = bt_le_scan_start(BT_LE_SCAN_PASSIVE, split_central_device_found);
+    if (err == -EALREADY) {
+        return 0;
+    }
     if (err) {
         LOG_ERR("Scanning failed to start (err %d)", err);
         return err;
@@ -286,14 +604,20 @@ static int start_scan(void) {
 
 static void split_central_connected(struct bt_conn *conn, uint8_t conn_err) {
     char addr[BT_ADDR_LE_STR_LEN];
+    struct peripheral_slot *slot = peripheral_slot_for_conn(conn);
+
+    if (slot == NULL) {
+        return;
+    }
 
     bt_addr_le_to_str(bt_conn_get_dst(conn), addr, sizeof(addr));
 
     if (conn_err) {
         LOG_ERR("Failed to connect to %s (%u)", log_strdup(addr), conn_err);
 
-        bt_conn_unref(default_conn);
-        default_conn = NULL;
+        bt_conn_unref(slot->conn);
+        slot->conn = NULL;
+        slot->state = PERIPHERAL_SLOT_STATE_OPEN;
 
         start_scan();
         return;
@@ -301,29 +625,58 @@ static void split_central_connected(struct bt_conn *conn, uint8_t conn_err) {
 
     LOG_DBG("Connected: %s", log_strdup(addr));
 
-    split_central_process_connection(conn);
+    slot->state = PERIPHERAL_SLOT_STATE_CONNECTED;
+    split_central_process_connection(slot);
+
+    start_scan();
 }
 
 static void split_central_disconnected(struct bt_conn *conn, uint8_t reason) {
     char addr[BT_ADDR_LE_STR_LEN];
+    struct peripheral_slot *slot = peripheral_slot_for_conn(conn);
 
     bt_addr_le_to_str(bt_conn_get_dst(conn), addr, sizeof(addr));
 
     LOG_DBG("Disconnected: %s (reason %d)", log_strdup(addr), reason);
 
-    if (default_conn != conn) {
+    if (slot == NULL) {
         return;
     }
 
-    bt_conn_unref(default_conn);
-    default_conn = NULL;
+    bt_conn_unref(slot->conn);
+    slot->conn = NULL;
+    slot->state = PERIPHERAL_SLOT_STATE_OPEN;
+
+    // Keys held on the peripheral would otherwise stay pressed until it reconnects.
+    release_peripheral_positions(slot);
+
+    slot->position_state_synced = false;
+    slot->resyncing = false;
+    // The peripheral may have rebooted, which restarts its clock.
+    zmk_split_clock_reset(&slot->clock);
 
     start_scan();
 }
 
+static void split_central_security_changed(struct bt_conn *conn, bt_security_t level,
+                                           enum bt_security_err security_err) {
+    struct peripheral_slot *slot = peripheral_slot_for_conn(conn);
+
+    if (slot == NULL || security_err) {
+        return;
+    }
+
+    // The central state can only be written once the connection is encrypted.
+    int err = write_central_state(slot);
+    if (err) {
+        LOG_ERR("Failed to write the central state (err %d)", err);
+    }
+}
+
 static struct bt_conn_cb conn_callbacks = {
     .connected = split_central_connected,
     .disconnected = split_central_disconnected,
+    .security_changed = split_central_security_changed,
 };
 
 int zmk_split_bt_central_init(const struct device *_arg) {
@@ -6,82 +6,181 @@
 
 #include <zephyr/types.h>
 #include <sys/util.h>
+#include <sys/byteorder.h>
 #include <init.h>
+#include <kernel.h>
 
 #include <logging/log.h>
 
 LOG_MODULE_DECLARE(zmk, CONFIG_ZMK_LOG_LEVEL);
 
+#include <bluetooth/conn.h>
 #include <bluetooth/gatt.h>
 #include <bluetooth/uuid.h>
 
 #include <zmk/matrix.h>
 #include <zmk/split/bluetooth/uuid.h>
-#include <zmk/split/bluetooth/service.h>
+#include <zmk/split/bluetooth/protocol.h>
+#include <zmk/split/peripheral.h>
 
-#define POS_STATE_LEN 16
+static uint16_t num_of_positions = sys_cpu_to_le16(ZMK_KEYMAP_LEN);
 
-static uint8_t num_of_positions = ZMK_KEYMAP_LEN;
-static uint8_t position_state[POS_STATE_LEN];
+// Guards position_state, which the central may read from the Bluetooth thread at any time.
+static struct k_spinlock position_state_lock;
+static struct zmk_split_bt_position_state position_state = {
+    .position_offset = sys_cpu_to_le16(CONFIG_ZMK_SPLIT_BLE_PERIPHERAL_POSITION_OFFSET),
+};
+
+// Copy of position_state served to a read that takes several ATT requests, so all parts of it
+// come from the same state. It is taken when a read starts at offset 0.
+static struct zmk_split_bt_position_state position_state_snapshot;
+
+static uint32_t position_event_overflows = 0;
 
 static ssize_t split_svc_pos_state(struct bt_conn *conn, const struct bt_gatt_attr *attrs,
                                    void *buf, uint16_t len, uint16_t offset) {
-    return bt_gatt_attr_read(conn, attrs, buf, len, offset, &position_state,
-                             sizeof(position_state));
+    if (offset == 0) {
+        k_spinlock_key_t key = k_spin_lock(&position_state_lock);
+        position_state_snapshot = position_state;
+        k_spin_unlock(&position_state_lock, key);
+    }
+
+    return bt_gatt_attr_read(conn, attrs, buf, len, offset, &position_state_snapshot,
+                             sizeof(position_state_snapshot));
 }
 
 static ssize_t split_svc_num_of_positions(struct bt_conn *conn, const struct bt_gatt_attr *attrs,
                                           void *buf, uint16_t len, uint16_t offset) {
-    return bt_gatt_attr_read(conn, attrs, buf, len, offset, attrs->user_data, sizeof(uint8_t));
+    return bt_gatt_attr_read(conn, attrs, buf, len, offset, attrs->user_data,
+                             sizeof(num_of_positions));
 }
 
-static void split_svc_pos_state_ccc(const struct bt_gatt_attr *attr, uint16_t value) {
+static void split_svc_pos_events_ccc(const struct bt_gatt_attr *attr, uint16_t value) {
     LOG_DBG("value %d", value);
 }
 
+static ssize_t split_svc_central_state(struct bt_conn *conn, const struct bt_gatt_attr *attr,
+                                       const void *buf, uint16_t len, uint16_t offset,
+                                       uint8_t flags) {
+    if (offset != 0) {
+        return BT_GATT_ERR(BT_ATT_ERR_INVALID_OFFSET);
+    }
+
+    zmk_split_peripheral_central_state_received(buf, len);
+
+    return len;
+}
+
 BT_GATT_SERVICE_DEFINE(
     split_svc, BT_GATT_PRIMARY_SERVICE(BT_UUID_DECLARE_128(ZMK_SPLIT_BT_SERVICE_UUID)),
     BT_GATT_CHARACTERISTIC(BT_UUID_DECLARE_128(ZMK_SPLIT_BT_CHAR_POSITION_STATE_UUID),
-                           BT_GATT_CHRC_READ | BT_GATT_CHRC_NOTIFY, BT_GATT_PERM_READ_ENCRYPT,
-                           split_svc_pos_state, NULL, &position_state),
-    BT_GATT_CCC(split_svc_pos_state_ccc, BT_GATT_PERM_READ_ENCRYPT | BT_GATT_PERM_WRITE_ENCRYPT),
+                           BT_GATT_CHRC_READ, BT_GATT_PERM_READ_ENCRYPT, split_svc_pos_state, NULL,
+                           NULL),
     BT_GATT_DESCRIPTOR(BT_UUID_NUM_OF_DIGITALS, BT_GATT_PERM_READ, split_svc_num_of_positions, NULL,
-                       &num_of_positions), );
+                       &num_of_positions),
+    BT_GATT_CHARACTERISTIC(BT_UUID_DECLARE_128(ZMK_SPLIT_BT_CHAR_POSITION_EVENTS_UUID),
+                           BT_GATT_CHRC_NOTIFY, BT_GATT_PERM_NONE, NULL, NULL, NULL),
+    BT_GATT_CCC(split_svc_pos_events_ccc, BT_GATT_PERM_READ_ENCRYPT | BT_GATT_PERM_WRITE_ENCRYPT),
+    BT_GATT_CHARACTERISTIC(BT_UUID_DECLARE_128(ZMK_SPLIT_BT_CHAR_CENTRAL_STATE_UUID),
+                           BT_GATT_CHRC_WRITE_WITHOUT_RESP, BT_GATT_PERM_WRITE_ENCRYPT, NULL,
+                           split_svc_central_state, NULL), );
 
 K_THREAD_STACK_DEFINE(service_q_stack, CONFIG_ZMK_SPLIT_BLE_PERIPHERAL_STACK_SIZE);
 
 struct k_work_q service_work_q;
 
-K_MSGQ_DEFINE(position_state_msgq, sizeof(char[POS_STATE_LEN]),
+K_MSGQ_DEFINE(position_event_msgq, sizeof(struct zmk_split_bt_position_event),
               CONFIG_ZMK_SPLIT_BLE_PERIPHERAL_POSITION_QUEUE_SIZE, 4);
 
-void send_position_state_callback(struct k_work *work) {
-    uint8_t state[POS_STATE_LEN];
+#define NOTIFY_RETRY_MS 10
+
+// Events taken from the queue that were not notified yet, only used by the work queue.
+static struct zmk_split_bt_position_event pending_events[ZMK_SPLIT_BT_POSITION_EVENTS_PER_NOTIFY];
+static int pending_count;
+
+// Set when an event was dropped, guarded by position_state_lock.
+static bool sequence_hint_pending;
+
+static struct k_delayed_work notify_retry_work;
+
+static void take_pending_events() {
+    while (pending_count < ARRAY_SIZE(pending_events) &&
+           k_msgq_get(&position_event_msgq, &pending_events[pending_count], K_NO_WAIT) == 0) {
+        pending_count++;
+    }
+
+    if (pending_count == ARRAY_SIZE(pending_events)) {
+        return;
+    }
+
+    // The queue ran empty, so the hint goes out after every event sent before the dropped one.
+    // An event queued since then makes the central resync once more than needed.
+    k_spinlock_key_t key = k_spin_lock(&position_state_lock);
+    if (sequence_hint_pending) {
+        sequence_hint_pending = false;
+        pending_events[pending_count++] = (struct zmk_split_bt_position_event){
+            .position = sys_cpu_to_le16(ZMK_SPLIT_BT_POSITION_SEQUENCE_HINT),
+            .sequence_state = position_state.sequence,
+        };
+    }
+    k_spin_unlock(&position_state_lock, key);
+}
+
+void send_position_events_callback(struct k_work *work) {
+    // Events queued while the previous notification was being sent go out together.
+    while (true) {
+        take_pending_events();
+        if (pending_count == 0) {
+            return;
+        }
+
+        int err = bt_gatt_notify(NULL, &split_svc.attrs[4], pending_events,
+                                 pending_count * sizeof(pending_events[0]));
+        if (err == -ENOTCONN) {
+            // The central reads the full position state once it is connected again.
+            pending_count = 0;
+            k_msgq_purge(&position_event_msgq);
+            return;
+        }
 
-    while (k_msgq_get(&position_state_msgq, &state, K_NO_WAIT) == 0) {
-        int err = bt_gatt_notify(NULL, &split_svc.attrs[1], &state, sizeof(state));
         if (err) {
-            LOG_DBG("Error notifying %d", err);
+            LOG_WRN("Failed to notify position events (err %d), retrying", err);
+            k_delayed_work_submit_to_queue(&service_work_q, &notify_retry_work,
+                                           K_MSEC(NOTIFY_RETRY_MS));
+            return;
+        }
+
+        bool full = pending_count == ARRAY_SIZE(pending_events);
+        pending_count = 0;
+        if (!full) {
+            return;
         }
     }
 };
 
-K_WORK_DEFINE(service_position_notify_work, send_position_state_callback);
-
-int send_position_state() {
-    int err = k_msgq_put(&position_state_msgq, position_state, K_MSEC(100));
-    if (err) {
-        switch (err) {
-        case -EAGAIN: {
-            LOG_WRN("Position state message queue full, popping first message and queueing again");
-            uint8_t discarded_state[POS_STATE_LEN];
-            k_msgq_get(&position_state_msgq, &discarded_state, K_NO_WAIT);
-            return send_position_state();
-        }
-        default:
-            LOG_WRN("Failed to queue position state to send (%d)", err);
-            return err;
-        }
+K_WORK_DEFINE(service_position_notify_work, send_position_events_callback);
+
+static int send_position_event(uint32_t position, bool pressed, int64_t timestamp) {
+    k_spinlock_key_t key = k_spin_lock(&position_state_lock);
+    WRITE_BIT(position_state.positions[position / 8], position % 8, pressed);
+    position_state.sequence = (position_state.sequence + 1) & ZMK_SPLIT_BT_EVENT_SEQUENCE_MASK;
+    struct zmk_split_bt_position_event event = {
+        .position = sys_cpu_to_le16(position),
+        .sequence_state = position_state.sequence | (pressed ? ZMK_SPLIT_BT_EVENT_PRESSED : 0),
+        .timestamp = sys_cpu_to_le16((uint16_t)timestamp),
+    };
+    k_spin_unlock(&position_state_lock, key);
+
+    // A dropped event still used up its sequence number, so the central notices the gap with the
+    // next event or the sequence hint sent once the queue drained, and reads the full state.
+    if (k_msgq_put(&position_event_msgq, &event, K_NO_WAIT) != 0) {
+        key = k_spin_lock(&position_state_lock);
+        sequence_hint_pending = true;
+        k_spin_unlock(&position_state_lock, key);
+
+        position_event_overflows++;
+        LOG_WRN("Position event queue full (%d overflows so far), central will resync",
+                position_event_overflows);
     }
 
     k_work_submit_to_queue(&service_work_q, &service_position_notify_work);
@@ -89,17 +188,27 @@ int send_position_state() {
     return 0;
 }
 
-int zmk_split_bt_position_pressed(uint8_t position) {
-    WRITE_BIT(position_state[position / 8], position % 8, true);
-    return send_position_state();
+int zmk_split_peripheral_position_pressed(uint32_t position, int64_t timestamp) {
+    return send_position_event(position, true, timestamp);
+}
+
+int zmk_split_peripheral_position_released(uint32_t position, int64_t timestamp) {
+    return send_position_event(position, false, timestamp);
 }
 
-int zmk_split_bt_position_released(uint8_t position) {
-    WRITE_BIT(position_state[position / 8], position % 8, false);
-    return send_position_state();
+static void split_svc_disconnected(struct bt_conn *conn, uint8_t reason) {
+    zmk_split_peripheral_central_state_lost();
 }
 
+static struct bt_conn_cb conn_callbacks = {
+    .disconnected = split_svc_disconnected,
+};
+
 int service_init(const struct device *_arg) {
+    bt_conn_cb_register(&conn_callbacks);
+
+    k_delayed_work_init(&notify_retry_work, send_position_events_callback);
+
     k_work_q_start(&service_work_q, service_q_stack, K_THREAD_STACK_SIZEOF(service_q_stack),
                    CONFIG_ZMK_SPLIT_BLE_PERIPHERAL_PRIORITY);
 
@@ -0,0 +1,109 @@
+/*
+ * Copyright (c) 2020 The ZMK Contributors
+ *
+ * SPDX-License-Identifier: MIT
+ */
+
+#include <kernel.h>
+
+#include <logging/log.h>
+
+LOG_MODULE_DECLARE(zmk, CONFIG_ZMK_LOG_LEVEL);
+
+#include <zmk/matrix.h>
+#include <zmk/split/central.h>
+#include <zmk/event_manager.h>
+#include <zmk/events/position_state_changed.h>
+
+#define POSITION_WORDS ceiling_fraction(ZMK_KEYMAP_LEN, 32)
+
+K_MSGQ_DEFINE(peripheral_event_msgq, sizeof(struct zmk_position_state_changed),
+              CONFIG_ZMK_SPLIT_CENTRAL_POSITION_QUEUE_SIZE, 4);
+
+// Guards peripheral_state, peripheral_state_dirty and peripheral_event_msgq as a unit. When the
+// queue overflows, the positions reported by the peripherals replace the queued events.
+static struct k_spinlock peripheral_state_lock;
+static uint32_t peripheral_state[POSITION_WORDS];
+static bool peripheral_state_dirty;
+// Timestamp of the last change included in the dirty state.
+static int64_t peripheral_state_timestamp;
+
+// The peripheral positions raised as events, only used by the work item.
+static uint32_t raised_state[POSITION_WORDS];
+
+static uint32_t peripheral_event_overflows = 0;
+
+static void raise_position_state_changed(struct zmk_position_state_changed ev) {
+    WRITE_BIT(raised_state[ev.position / 32], ev.position % 32, ev.state);
+
+    LOG_DBG("Trigger key position state change for %d", ev.position);
+    ZMK_EVENT_RAISE(new_zmk_position_state_changed(ev));
+}
+
+static void apply_peripheral_state(const uint32_t *state, int64_t timestamp) {
+    // Release keys before pressing new ones, the order of the lost events is unknown anyway.
+    for (int pressed = 0; pressed <= 1; pressed++) {
+        for (int word = 0; word < POSITION_WORDS; word++) {
+            uint32_t changed = state[word] ^ raised_state[word];
+            changed &= pressed ? state[word] : ~state[word];
+            for (; changed; changed &= changed - 1) {
+                raise_position_state_changed((struct zmk_position_state_changed){
+                    .position = word * 32 + __builtin_ctz(changed),
+                    .state = pressed,
+                    .timestamp = timestamp});
+            }
+        }
+    }
+}
+
+void peripheral_event_work_callback(struct k_work *work) {
+    struct zmk_position_state_changed ev;
+    while (k_msgq_get(&peripheral_event_msgq, &ev, K_NO_WAIT) == 0) {
+        raise_position_state_changed(ev);
+    }
+
+    uint32_t state[POSITION_WORDS];
+    int64_t timestamp;
+
+    k_spinlock_key_t key = k_spin_lock(&peripheral_state_lock);
+    bool dirty = peripheral_state_dirty;
+    if (dirty) {
+        peripheral_state_dirty = false;
+        // Anything queued since the loop above is included in the state.
+        k_msgq_purge(&peripheral_event_msgq);
+        memcpy(state, peripheral_state, sizeof(state));
+        timestamp = peripheral_state_timestamp;
+    }
+    k_spin_unlock(&peripheral_state_lock, key);
+
+    if (dirty) {
+        apply_peripheral_state(state, timestamp);
+    }
+}
+
+K_WORK_DEFINE(peripheral_event_work, peripheral_event_work_callback);
+
+void zmk_split_central_position_state_changed(uint32_t position, bool pressed, int64_t timestamp) {
+    struct zmk_position_state_changed ev = {
+        .position = position, .state = pressed, .timestamp = timestamp};
+    bool overflowed = false;
+
+    k_spinlock_key_t key = k_spin_lock(&peripheral_state_lock);
+    WRITE_BIT(peripheral_state[position / 32], position % 32, pressed);
+    if (peripheral_state_dirty) {
+        peripheral_state_timestamp = MAX(timestamp, peripheral_state_timestamp);
+    } else if (k_msgq_put(&peripheral_event_msgq, &ev, K_NO_WAIT) != 0) {
+        overflowed = true;
+        peripheral_state_dirty = true;
+        peripheral_state_timestamp = timestamp;
+    }
+    k_spin_unlock(&peripheral_state_lock, key);
+
+    if (overflowed) {
+        peripheral_event_overflows++;
+        LOG_WRN("Peripheral position event queue full (%d overflows so far), using the state",
+                peripheral_event_overflows);
+    }
+
+    k_work_submit(&peripheral_event_work);
+}
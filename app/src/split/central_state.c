@@ -0,0 +1,119 @@
+/*
+ * Copyright (c) 2020 The ZMK Contributors
+ *
+ * SPDX-License-Identifier: MIT
+ */
+
+#include <device.h>
+#include <init.h>
+#include <kernel.h>
+#include <sys/byteorder.h>
+
+#include <logging/log.h>
+
+LOG_MODULE_DECLARE(zmk, CONFIG_ZMK_LOG_LEVEL);
+
+#include <zmk/activity.h>
+#include <zmk/keymap.h>
+#include <zmk/event_manager.h>
+#include <zmk/events/activity_state_changed.h>
+#include <zmk/events/layer_state_changed.h>
+#include <zmk/split/central.h>
+#include <zmk/split/central_state.h>
+
+#if IS_ENABLED(CONFIG_ZMK_RGB_UNDERGLOW)
+#include <zmk/rgb_underglow.h>
+#include <zmk/events/rgb_underglow_state_changed.h>
+#endif
+
+// The state is rebuilt from the current layers, activity and underglow whenever one of them
+// changes, and sent if it differs from the last state sent. Changes within
+// CONFIG_ZMK_SPLIT_CENTRAL_STATE_MIN_INTERVAL of the last send are sent together.
+
+static struct zmk_split_central_state sent_state;
+static bool state_sent;
+static int64_t last_sent_at;
+
+static struct k_delayed_work send_state_work;
+
+static void build_state(struct zmk_split_central_state *state) {
+    zmk_keymap_layers_state_t layers =
+        zmk_keymap_layer_state() | BIT64(zmk_keymap_layer_default());
+
+    *state = (struct zmk_split_central_state){
+        .layers = sys_cpu_to_le64(layers),
+        .activity = zmk_activity_get_state(),
+    };
+
+#if IS_ENABLED(CONFIG_ZMK_RGB_UNDERGLOW)
+    struct zmk_rgb_underglow_state underglow;
+    if (zmk_rgb_underglow_get_full_state(&underglow) == 0) {
+        state->flags |= ZMK_SPLIT_CENTRAL_STATE_UNDERGLOW;
+        if (underglow.on) {
+            state->flags |= ZMK_SPLIT_CENTRAL_STATE_UNDERGLOW_ON;
+        }
+        state->underglow_hue = sys_cpu_to_le16(underglow.color.h);
+        state->underglow_saturation = underglow.color.s;
+        state->underglow_brightness = underglow.color.b;
+        state->underglow_effect = underglow.current_effect;
+        state->underglow_speed = underglow.animation_speed;
+        state->underglow_animation_step = sys_cpu_to_le16(underglow.animation_step);
+    }
+#endif
+}
+
+static void send_state(struct k_work *work) {
+    struct zmk_split_central_state state;
+    build_state(&state);
+
+    // The animation step moves on every frame, it only tags along with other changes.
+    uint16_t animation_step = state.underglow_animation_step;
+    state.underglow_animation_step = sent_state.underglow_animation_step;
+    if (state_sent && memcmp(&state, &sent_state, sizeof(state)) == 0) {
+        return;
+    }
+    state.underglow_animation_step = animation_step;
+
+    int err = zmk_split_central_send_state(&state);
+    if (err) {
+        // Try again later, the state is rebuilt then anyway.
+        LOG_WRN("Failed to send the central state to the peripherals (err %d)", err);
+        k_delayed_work_submit(&send_state_work,
+                              K_MSEC(CONFIG_ZMK_SPLIT_CENTRAL_STATE_MIN_INTERVAL));
+        return;
+    }
+
+    sent_state = state;
+    state_sent = true;
+    last_sent_at = k_uptime_get();
+}
+
+static int schedule_send_state() {
+    if (k_delayed_work_remaining_get(&send_state_work) > 0) {
+        return 0;
+    }
+
+    int64_t wait = last_sent_at + CONFIG_ZMK_SPLIT_CENTRAL_STATE_MIN_INTERVAL - k_uptime_get();
+    return k_delayed_work_submit(&send_state_work, K_MSEC(MAX(wait, 0)));
+}
+
+int split_central_state_listener(const zmk_event_t *eh) {
+    schedule_send_state();
+    return ZMK_EV_EVENT_BUBBLE;
+}
+
+ZMK_LISTENER(split_central_state, split_central_state_listener);
+ZMK_SUBSCRIPTION(split_central_state, zmk_layer_state_changed);
+ZMK_SUBSCRIPTION(split_central_state, zmk_activity_state_changed);
+#if IS_ENABLED(CONFIG_ZMK_RGB_UNDERGLOW)
+ZMK_SUBSCRIPTION(split_central_state, zmk_rgb_underglow_state_changed);
+#endif
+
+static int split_central_state_init(const struct device *_arg) {
+    k_delayed_work_init(&send_state_work, send_state);
+
+    // Peripherals start out with the state of the central after it booted.
+    return schedule_send_state();
+}
+
+SYS_INIT(split_central_state_init, APPLICATION, CONFIG_APPLICATION_INIT_PRIORITY);
@@ -0,0 +1,45 @@
+/*
+ * Copyright (c) 2020 The ZMK Contributors
+ *
+ * SPDX-License-Identifier: MIT
+ */
+
+#include <kernel.h>
+
+#include <zmk/split/clock.h>
+
+// Every position event arrives some link delay after the peripheral scanned it, so the smallest
+// difference between arrival time and peripheral timestamp seen so far is the clock offset plus
+// the shortest link delay. Events that arrive later than that, e.g. because they waited for a
+// connection event or a retransmission, get the extra delay taken off their timestamp. The
+// minimum is kept over two rotating windows so it follows the drift between the two clocks.
+#define CLOCK_WINDOW_MS 10000
+
+// Offsets are compared modulo 2^16 as the peripheral timestamps wrap every 65 seconds.
+static bool offset_less(uint16_t a, uint16_t b) { return (int16_t)(a - b) < 0; }
+
+void zmk_split_clock_reset(struct zmk_split_clock *clock) { clock->synced = false; }
+
+int64_t zmk_split_clock_map(struct zmk_split_clock *clock, uint16_t timestamp,
+                            int64_t received_at) {
+    uint16_t offset = (uint16_t)received_at - timestamp;
+
+    if (!clock->synced) {
+        clock->synced = true;
+        clock->window_start = received_at;
+        clock->window_min_offset = offset;
+        clock->previous_window_min_offset = offset;
+    } else if (received_at - clock->window_start >= CLOCK_WINDOW_MS) {
+        clock->window_start = received_at;
+        clock->previous_window_min_offset = clock->window_min_offset;
+        clock->window_min_offset = offset;
+    } else if (offset_less(offset, clock->window_min_offset)) {
+        clock->window_min_offset = offset;
+    }
+
+    uint16_t min_offset = offset_less(clock->previous_window_min_offset, clock->window_min_offset)
+                              ? clock->previous_window_min_offset
+                              : clock->window_min_offset;
+
+    return received_at - (uint16_t)(offset - min_offset);
+}
@@ -0,0 +1,115 @@
+/*
+ * Copyright (c) 2020 The ZMK Contributors
+ *
+ * SPDX-License-Identifier: MIT
+ */
+
+#include <kernel.h>
+#include <sys/byteorder.h>
+
+#include <logging/log.h>
+
+LOG_MODULE_DECLARE(zmk, CONFIG_ZMK_LOG_LEVEL);
+
+#include <zmk/activity.h>
+#include <zmk/event_manager.h>
+#include <zmk/events/layer_state_changed.h>
+#include <zmk/split/central_state.h>
+#include <zmk/split/peripheral.h>
+
+#if IS_ENABLED(CONFIG_ZMK_RGB_UNDERGLOW)
+#include <zmk/rgb_underglow.h>
+#endif
+
+// Guards received_state and state_received, written by the transport from its own thread.
+static struct k_spinlock received_state_lock;
+static struct zmk_split_central_state received_state;
+static bool state_received;
+
+// The layers the peripheral raised layer events for.
+static uint64_t applied_layers;
+
+static void apply_layers(uint64_t layers) {
+    for (uint8_t layer = 0; layer < 64; layer++) {
+        bool active = layers & BIT64(layer);
+        if (active != (bool)(applied_layers & BIT64(layer))) {
+            applied_layers ^= BIT64(layer);
+            ZMK_EVENT_RAISE(create_layer_state_changed(layer, active));
+        }
+    }
+}
+
+#if IS_ENABLED(CONFIG_ZMK_RGB_UNDERGLOW)
+static void apply_underglow(const struct zmk_split_central_state *state) {
+    if (!(state->flags & ZMK_SPLIT_CENTRAL_STATE_UNDERGLOW)) {
+        return;
+    }
+
+    struct zmk_rgb_underglow_state underglow = {
+        .color =
+            {
+                .h = sys_le16_to_cpu(state->underglow_hue),
+                .s = state->underglow_saturation,
+                .b = state->underglow_brightness,
+            },
+        .animation_speed = state->underglow_speed,
+        .current_effect = state->underglow_effect,
+        .animation_step = sys_le16_to_cpu(state->underglow_animation_step),
+        .on = state->flags & ZMK_SPLIT_CENTRAL_STATE_UNDERGLOW_ON,
+    };
+
+    int err = zmk_rgb_underglow_set_full_state(&underglow);
+    if (err) {
+        LOG_WRN("Failed to mirror the underglow of the central (err %d)", err);
+    }
+}
+#endif
+
+static void apply_central_state(struct k_work *work) {
+    struct zmk_split_central_state state;
+    bool received;
+
+    k_spinlock_key_t key = k_spin_lock(&received_state_lock);
+    state = received_state;
+    received = state_received;
+    k_spin_unlock(&received_state_lock, key);
+
+    if (!received) {
+        // Layers of the central no longer apply, its activity no longer keeps the peripheral
+        // awake. The underglow stays as it was.
+        apply_layers(0);
+        zmk_activity_set_central_state(ZMK_ACTIVITY_SLEEP);
+        return;
+    }
+
+    apply_layers(sys_le64_to_cpu(state.layers));
+    zmk_activity_set_central_state(state.activity);
+
+#if IS_ENABLED(CONFIG_ZMK_RGB_UNDERGLOW)
+    apply_underglow(&state);
+#endif
+}
+
+K_WORK_DEFINE(apply_central_state_work, apply_central_state);
+
+void zmk_split_peripheral_central_state_received(const void *state, size_t len) {
+    struct zmk_split_central_state new_state = {0};
+
+    // Older centrals send a shorter state, the missing fields stay zero.
+    memcpy(&new_state, state, MIN(len, sizeof(new_state)));
+
+    k_spinlock_key_t key = k_spin_lock(&received_state_lock);
+    received_state = new_state;
+    state_received = true;
+    k_spin_unlock(&received_state_lock, key);
+
+    k_work_submit(&apply_central_state_work);
+}
+
+void zmk_split_peripheral_central_state_lost() {
+    k_spinlock_key_t key = k_spin_lock(&received_state_lock);
+    state_received = false;
+    k_spin_unlock(&received_state_lock, key);
+
+    k_work_submit(&apply_central_state_work);
+}
@@ -0,0 +1,228 @@
+/*
+ * Copyright (c) 2020 The ZMK Contributors
+ *
+ * SPDX-License-Identifier: MIT
+ */
+
+#include <device.h>
+#include <init.h>
+#include <kernel.h>
+#include <sys/byteorder.h>
+
+#include <logging/log.h>
+
+LOG_MODULE_DECLARE(zmk, CONFIG_ZMK_LOG_LEVEL);
+
+#include <zmk/matrix.h>
+#include <zmk/split/central.h>
+#include <zmk/split/clock.h>
+#include <zmk/split/uart/link.h>
+#include <zmk/split/uart/protocol.h>
+
+// Position event frames are only applied in sequence. Until a position state frame arrived the
+// central does not know the sequence numbers or the keys held on the peripheral, so it asks for
+// the state instead of applying events.
+static bool synced;
+static uint8_t next_sequence;
+
+// Added to the positions of the peripheral, part of the position state it sends.
+static uint32_t position_offset;
+
+// The keymap positions the central raised events for.
+static uint8_t position_state[ZMK_SPLIT_UART_POSITION_STATE_LEN];
+
+static struct zmk_split_clock peripheral_clock;
+
+// The last timestamp raised for the peripheral, so its events never go back in time.
+static int64_t last_position_timestamp;
+
+// The last central state, sent again until the peripheral acks it.
+static struct zmk_split_central_state central_state;
+static bool central_state_set;
+static bool central_state_acked;
+static uint8_t central_state_sequence;
+
+static struct k_delayed_work central_state_retransmit_work;
+static struct k_delayed_work link_timeout_work;
+
+static void raise_position_state_changed(uint32_t position, bool pressed, int64_t timestamp) {
+    WRITE_BIT(position_state[position / 8], position % 8, pressed);
+
+    last_position_timestamp = MAX(timestamp, last_position_timestamp);
+
+    zmk_split_central_position_state_changed(position, pressed, last_position_timestamp);
+}
+
+static void release_peripheral_positions() {
+    int64_t now = k_uptime_get();
+
+    for (uint32_t position = 0; position < ZMK_KEYMAP_LEN; position++) {
+        if (position_state[position / 8] & BIT(position % 8)) {
+            raise_position_state_changed(position, false, now);
+        }
+    }
+}
+
+static void apply_position_state(const uint8_t *payload, size_t len) {
+    struct zmk_split_uart_position_state state;
+    // Positions beyond the keymap of the central are dropped.
+    len = MIN(len, sizeof(state));
+    memcpy(&state, payload, len);
+    size_t positions_len = len - offsetof(struct zmk_split_uart_position_state, positions);
+    int64_t now = k_uptime_get();
+
+    position_offset = sys_le16_to_cpu(state.position_offset);
+
+    // Release keys before pressing new ones, the order of the missed events is lost anyway.
+    for (int pressed = 0; pressed <= 1; pressed++) {
+        for (uint32_t i = 0; i < positions_len * 8; i++) {
+            uint32_t position = position_offset + i;
+            if (position >= ZMK_KEYMAP_LEN) {
+                break;
+            }
+
+            bool was_pressed = position_state[position / 8] & BIT(position % 8);
+            bool is_pressed = state.positions[i / 8] & BIT(i % 8);
+            if (is_pressed == pressed && was_pressed != pressed) {
+                raise_position_state_changed(position, pressed, now);
+            }
+        }
+    }
+}
+
+static void apply_position_events(const uint8_t *payload, size_t len, int64_t received_at) {
+    const struct zmk_split_uart_position_event *events =
+        (const struct zmk_split_uart_position_event *)payload;
+
+    for (int i = 0; i < len / sizeof(events[0]); i++) {
+        uint32_t position = sys_le16_to_cpu(events[i].position) + position_offset;
+        if (position >= ZMK_KEYMAP_LEN) {
+            LOG_ERR("Invalid position %d", position);
+            continue;
+        }
+
+        int64_t timestamp = zmk_split_clock_map(
+            &peripheral_clock, sys_le16_to_cpu(events[i].timestamp), received_at);
+        raise_position_state_changed(position, events[i].pressed, timestamp);
+    }
+}
+
+static void send_ack() {
+    zmk_split_uart_link_send(ZMK_SPLIT_UART_FRAME_ACK, next_sequence, NULL, 0);
+}
+
+static void send_resync() { zmk_split_uart_link_send(ZMK_SPLIT_UART_FRAME_RESYNC, 0, NULL, 0); }
+
+static void send_central_state() {
+    zmk_split_uart_link_send(ZMK_SPLIT_UART_FRAME_CENTRAL_STATE, central_state_sequence,
+                             &central_state, sizeof(central_state));
+    k_delayed_work_submit(&central_state_retransmit_work,
+                          K_MSEC(CONFIG_ZMK_SPLIT_UART_RETRANSMIT_MS));
+}
+
+static void central_state_retransmit_callback(struct k_work *work) {
+    if (central_state_set && !central_state_acked) {
+        send_central_state();
+    }
+}
+
+int zmk_split_central_send_state(const struct zmk_split_central_state *state) {
+    central_state = *state;
+    central_state_set = true;
+    central_state_acked = false;
+    // Acks for the previous state no longer count.
+    central_state_sequence++;
+
+    send_central_state();
+    return 0;
+}
+
+static void link_timeout_callback(struct k_work *work) {
+    LOG_WRN("Split UART link timed out, releasing the peripheral's keys");
+    // The peripheral keeps sending keepalives or resets, the first frame after the link is back
+    // asks for the position state.
+    synced = false;
+    release_peripheral_positions();
+}
+
+static void handle_frame(const struct zmk_split_uart_frame_header *header, const uint8_t *payload,
+                         size_t len) {
+    int64_t received_at = k_uptime_get();
+
+    k_delayed_work_submit(&link_timeout_work, K_MSEC(ZMK_SPLIT_UART_LINK_TIMEOUT_MS));
+
+    switch (header->type) {
+    case ZMK_SPLIT_UART_FRAME_RESET:
+        LOG_DBG("Peripheral started");
+        synced = false;
+        // The peripheral clock restarted.
+        zmk_split_clock_reset(&peripheral_clock);
+        send_resync();
+        if (central_state_set) {
+            central_state_acked = false;
+            send_central_state();
+        }
+        break;
+    case ZMK_SPLIT_UART_FRAME_ACK:
+        if (header->sequence == central_state_sequence) {
+            central_state_acked = true;
+            k_delayed_work_cancel(&central_state_retransmit_work);
+        }
+        break;
+    case ZMK_SPLIT_UART_FRAME_POSITION_STATE:
+        // The state replaces everything before it, so it may skip ahead. Older copies that were
+        // sent again because an ack got lost are ignored.
+        if (synced && (uint8_t)(header->sequence - next_sequence) >= 0x80) {
+            send_ack();
+            break;
+        }
+
+        if (len < offsetof(struct zmk_split_uart_position_state, positions)) {
+            LOG_ERR("Invalid position state length %d", len);
+            break;
+        }
+
+        apply_position_state(payload, len);
+        synced = true;
+        next_sequence = header->sequence + 1;
+        send_ack();
+        break;
+    case ZMK_SPLIT_UART_FRAME_POSITION_EVENTS:
+        if (!synced) {
+            send_resync();
+            break;
+        }
+
+        // Frames after a lost one are dropped, the peripheral sends them again in order.
+        if (header->sequence == next_sequence) {
+            apply_position_events(payload, len, received_at);
+            next_sequence++;
+        }
+        send_ack();
+        break;
+    case ZMK_SPLIT_UART_FRAME_KEEPALIVE:
+        if (!synced) {
+            send_resync();
+        }
+        break;
+    default:
+        LOG_WRN("Unexpected split UART frame type %d", header->type);
+        break;
+    }
+}
+
+static int split_uart_central_init(const struct device *_arg) {
+    k_delayed_work_init(&central_state_retransmit_work, central_state_retransmit_callback);
+    k_delayed_work_init(&link_timeout_work, link_timeout_callback);
+
+    int err = zmk_split_uart_link_init(handle_frame);
+    if (err) {
+        return err;
+    }
+
+    // The peripheral may already be running if only the central restarted.
+    send_resync();
+    return 0;
+}
+
+SYS_INIT(split_uart_central_init, APPLICATION, CONFIG_APPLICATION_INIT_PRIORITY);
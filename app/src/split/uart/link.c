@@ -0,0 +1,168 @@
+/*
+ * Copyright (c) 2020 The ZMK Contributors
+ *
+ * SPDX-License-Identifier: MIT
+ */
+
+#include <kernel.h>
+#include <sys/byteorder.h>
+#include <sys/crc.h>
+
+#include <logging/log.h>
+
+LOG_MODULE_DECLARE(zmk, CONFIG_ZMK_LOG_LEVEL);
+
+#include <zmk/split/uart/link.h>
+#include <zmk/split/uart/protocol.h>
+#include <zmk/split/uart/transport.h>
+
+#define CRC_LEN ZMK_SPLIT_UART_CRC_LEN
+#define MAX_FRAME_LEN ZMK_SPLIT_UART_MAX_FRAME_LEN
+#define MAX_ENCODED_FRAME_LEN ZMK_SPLIT_UART_MAX_ENCODED_FRAME_LEN
+
+static zmk_split_uart_frame_handler_t frame_handler;
+
+// The frame being received, without the flags and escapes.
+static uint8_t rx_frame[MAX_FRAME_LEN];
+static size_t rx_frame_len;
+static bool rx_escaped;
+static bool rx_frame_dropped;
+
+struct received_frame {
+    uint8_t len;
+    uint8_t data[MAX_FRAME_LEN - CRC_LEN];
+};
+
+K_MSGQ_DEFINE(received_frame_msgq, sizeof(struct received_frame), 4, 4);
+
+static uint32_t rx_crc_errors = 0;
+static uint32_t rx_frame_overflows = 0;
+
+static size_t encode_byte(uint8_t *out, uint8_t byte) {
+    if (byte == ZMK_SPLIT_UART_FRAME_FLAG || byte == ZMK_SPLIT_UART_FRAME_ESCAPE) {
+        out[0] = ZMK_SPLIT_UART_FRAME_ESCAPE;
+        out[1] = byte ^ ZMK_SPLIT_UART_FRAME_ESCAPE_XOR;
+        return 2;
+    }
+
+    out[0] = byte;
+    return 1;
+}
+
+int zmk_split_uart_link_send(uint8_t type, uint8_t sequence, const void *payload, size_t len) {
+    uint8_t frame[MAX_FRAME_LEN];
+    uint8_t encoded[MAX_ENCODED_FRAME_LEN];
+    size_t frame_len = sizeof(struct zmk_split_uart_frame_header) + len;
+    size_t encoded_len = 0;
+
+    if (len > ZMK_SPLIT_UART_MAX_PAYLOAD_LEN) {
+        return -EINVAL;
+    }
+
+    struct zmk_split_uart_frame_header *header = (struct zmk_split_uart_frame_header *)frame;
+    header->type = type;
+    header->sequence = sequence;
+    memcpy(frame + sizeof(*header), payload, len);
+    sys_put_le16(crc16_ccitt(0xFFFF, frame, frame_len), frame + frame_len);
+    frame_len += CRC_LEN;
+
+    encoded[encoded_len++] = ZMK_SPLIT_UART_FRAME_FLAG;
+    for (int i = 0; i < frame_len; i++) {
+        encoded_len += encode_byte(&encoded[encoded_len], frame[i]);
+    }
+    encoded[encoded_len++] = ZMK_SPLIT_UART_FRAME_FLAG;
+
+    LOG_DBG("Sending frame type %d sequence %d", type, sequence);
+
+    int err = zmk_split_uart_transport_send(encoded, encoded_len);
+    if (err == -ENOMEM) {
+        LOG_WRN("Split UART send buffer full, dropping frame");
+    }
+
+    return err;
+}
+
+static void handle_received_frames(struct k_work *work) {
+    struct received_frame frame;
+
+    while (k_msgq_get(&received_frame_msgq, &frame, K_NO_WAIT) == 0) {
+        const struct zmk_split_uart_frame_header *header =
+            (const struct zmk_split_uart_frame_header *)frame.data;
+        LOG_DBG("Received frame type %d sequence %d length %d", header->type, header->sequence,
+                frame.len - sizeof(*header));
+        frame_handler(header, frame.data + sizeof(*header), frame.len - sizeof(*header));
+    }
+}
+
+K_WORK_DEFINE(received_frames_work, handle_received_frames);
+
+static void finish_frame() {
+    if (rx_frame_len < sizeof(struct zmk_split_uart_frame_header) + CRC_LEN) {
+        return;
+    }
+
+    size_t len = rx_frame_len - CRC_LEN;
+    if (crc16_ccitt(0xFFFF, rx_frame, len) != sys_get_le16(rx_frame + len)) {
+        rx_crc_errors++;
+        LOG_WRN("Split UART frame failed its CRC check (%d errors so far)", rx_crc_errors);
+        return;
+    }
+
+    struct received_frame frame = {.len = len};
+    memcpy(frame.data, rx_frame, len);
+    if (k_msgq_put(&received_frame_msgq, &frame, K_NO_WAIT) != 0) {
+        rx_frame_overflows++;
+        LOG_WRN("Split UART receive queue full (%d overflows so far), dropping frame",
+                rx_frame_overflows);
+        return;
+    }
+
+    k_work_submit(&received_frames_work);
+}
+
+static void receive_byte(uint8_t byte) {
+    if (byte == ZMK_SPLIT_UART_FRAME_FLAG) {
+        if (!rx_frame_dropped) {
+            finish_frame();
+        }
+        rx_frame_len = 0;
+        rx_escaped = false;
+        rx_frame_dropped = false;
+        return;
+    }
+
+    if (rx_frame_dropped) {
+        return;
+    }
+
+    if (byte == ZMK_SPLIT_UART_FRAME_ESCAPE) {
+        rx_escaped = true;
+        return;
+    }
+
+    if (rx_escaped) {
+        byte ^= ZMK_SPLIT_UART_FRAME_ESCAPE_XOR;
+        rx_escaped = false;
+    }
+
+    if (rx_frame_len == sizeof(rx_frame)) {
+        // Garbage or a frame from a newer protocol, skip to the next flag.
+        LOG_WRN("Split UART frame too long, skipping to the next flag");
+        rx_frame_dropped = true;
+        return;
+    }
+
+    rx_frame[rx_frame_len++] = byte;
+}
+
+static void receive_bytes(const uint8_t *data, size_t len) {
+    for (int i = 0; i < len; i++) {
+        receive_byte(data[i]);
+    }
+}
+
+int zmk_split_uart_link_init(zmk_split_uart_frame_handler_t handler) {
+    frame_handler = handler;
+
+    return zmk_split_uart_transport_init(receive_bytes);
+}
@@ -0,0 +1,263 @@
+/*
+ * Copyright (c) 2020 The ZMK Contributors
+ *
+ * SPDX-License-Identifier: MIT
+ */
+
+#include <device.h>
+#include <init.h>
+#include <kernel.h>
+#include <sys/byteorder.h>
+
+#include <logging/log.h>
+
+LOG_MODULE_DECLARE(zmk, CONFIG_ZMK_LOG_LEVEL);
+
+#include <zmk/split/peripheral.h>
+#include <zmk/split/uart/link.h>
+#include <zmk/split/uart/protocol.h>
+
+// Position changes are sent in sequenced frames, up to CONFIG_ZMK_SPLIT_UART_WINDOW_SIZE of
+// which may wait for the central's ack. The ack carries the sequence number of the next frame
+// the central expects, so it acks every frame before it. Frames that were not acked within the
+// retransmit timeout are all sent again, the central drops any frame that is not the one it
+// expects. When events are lost, because the queue overflowed or the central lost track after a
+// reboot, a position state frame brings the central back in sync. A keepalive frame tells the
+// central the link is still up while there is nothing else to send.
+
+struct sent_frame {
+    uint8_t type;
+    uint8_t len;
+    uint8_t payload[ZMK_SPLIT_UART_MAX_PAYLOAD_LEN];
+};
+
+static struct sent_frame window[CONFIG_ZMK_SPLIT_UART_WINDOW_SIZE];
+// Sequence number of the oldest frame that was not acked, and of the next frame to send.
+static uint8_t window_start;
+static uint8_t next_sequence;
+
+// Guards position_state, position_state_dirty and position_event_msgq as a unit, so a position
+// state frame covers exactly the events that were dropped from the queue.
+static struct k_spinlock position_state_lock;
+static struct zmk_split_uart_position_state position_state = {
+    .position_offset = sys_cpu_to_le16(CONFIG_ZMK_SPLIT_UART_POSITION_OFFSET),
+};
+static bool position_state_dirty = true;
+
+// Set once the central answered the reset sent after booting.
+static bool linked;
+
+static uint32_t position_event_overflows = 0;
+
+K_MSGQ_DEFINE(position_event_msgq, sizeof(struct zmk_split_uart_position_event),
+              CONFIG_ZMK_SPLIT_UART_POSITION_QUEUE_SIZE, 4);
+
+static struct k_delayed_work retransmit_work;
+static struct k_delayed_work keepalive_work;
+
+static int64_t last_sent_at;
+
+static void send_frame(uint8_t type, uint8_t sequence, const void *payload, size_t len) {
+    last_sent_at = k_uptime_get();
+    zmk_split_uart_link_send(type, sequence, payload, len);
+}
+
+static uint8_t window_len() { return next_sequence - window_start; }
+
+static struct sent_frame *window_frame(uint8_t sequence) {
+    return &window[sequence % CONFIG_ZMK_SPLIT_UART_WINDOW_SIZE];
+}
+
+static void send_window_frame(uint8_t sequence) {
+    struct sent_frame *frame = window_frame(sequence);
+    send_frame(frame->type, sequence, frame->payload, frame->len);
+}
+
+static bool state_frame_in_window() {
+    for (uint8_t sequence = window_start; sequence != next_sequence; sequence++) {
+        if (window_frame(sequence)->type == ZMK_SPLIT_UART_FRAME_POSITION_STATE) {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+// Builds the next frame from the queued events, returns false if there is nothing to send.
+static bool build_frame(struct sent_frame *frame) {
+    k_spinlock_key_t key = k_spin_lock(&position_state_lock);
+
+    if (position_state_dirty) {
+        position_state_dirty = false;
+        // The state includes every queued event.
+        k_msgq_purge(&position_event_msgq);
+        frame->type = ZMK_SPLIT_UART_FRAME_POSITION_STATE;
+        frame->len = sizeof(position_state);
+        memcpy(frame->payload, &position_state, sizeof(position_state));
+        k_spin_unlock(&position_state_lock, key);
+        return true;
+    }
+
+    struct zmk_split_uart_position_event *events =
+        (struct zmk_split_uart_position_event *)frame->payload;
+    int count = 0;
+    while (count < ZMK_SPLIT_UART_POSITION_EVENTS_PER_FRAME &&
+           k_msgq_get(&position_event_msgq, &events[count], K_NO_WAIT) == 0) {
+        count++;
+    }
+
+    k_spin_unlock(&position_state_lock, key);
+
+    frame->type = ZMK_SPLIT_UART_FRAME_POSITION_EVENTS;
+    frame->len = count * sizeof(events[0]);
+    return count > 0;
+}
+
+static void send_frames() {
+    if (!linked) {
+        return;
+    }
+
+    while (window_len() < CONFIG_ZMK_SPLIT_UART_WINDOW_SIZE &&
+           build_frame(window_frame(next_sequence))) {
+        send_window_frame(next_sequence++);
+    }
+
+    if (window_len() > 0 && !k_delayed_work_remaining_get(&retransmit_work)) {
+        k_delayed_work_submit(&retransmit_work, K_MSEC(CONFIG_ZMK_SPLIT_UART_RETRANSMIT_MS));
+    }
+}
+
+static void send_frames_callback(struct k_work *work) { send_frames(); }
+
+K_WORK_DEFINE(send_frames_work, send_frames_callback);
+
+static void retransmit_callback(struct k_work *work) {
+    if (!linked) {
+        send_frame(ZMK_SPLIT_UART_FRAME_RESET, 0, NULL, 0);
+        k_delayed_work_submit(&retransmit_work, K_MSEC(CONFIG_ZMK_SPLIT_UART_RETRANSMIT_MS));
+        return;
+    }
+
+    if (window_len() == 0) {
+        return;
+    }
+
+    LOG_DBG("Resending %d frames from %d", window_len(), window_start);
+    for (uint8_t sequence = window_start; sequence != next_sequence; sequence++) {
+        send_window_frame(sequence);
+    }
+
+    k_delayed_work_submit(&retransmit_work, K_MSEC(CONFIG_ZMK_SPLIT_UART_RETRANSMIT_MS));
+}
+
+static void schedule_keepalive() {
+    int64_t wait = last_sent_at + ZMK_SPLIT_UART_KEEPALIVE_MS - k_uptime_get();
+    k_delayed_work_submit(&keepalive_work, K_MSEC(MAX(wait, 0)));
+}
+
+static void keepalive_callback(struct k_work *work) {
+    if (k_uptime_get() - last_sent_at >= ZMK_SPLIT_UART_KEEPALIVE_MS) {
+        send_frame(ZMK_SPLIT_UART_FRAME_KEEPALIVE, 0, NULL, 0);
+    }
+
+    schedule_keepalive();
+}
+
+static void handle_ack(uint8_t sequence) {
+    uint8_t acked = sequence - window_start;
+    if (acked == 0 || acked > window_len()) {
+        return;
+    }
+
+    window_start = sequence;
+
+    k_delayed_work_cancel(&retransmit_work);
+    send_frames();
+}
+
+static void handle_frame(const struct zmk_split_uart_frame_header *header, const uint8_t *payload,
+                         size_t len) {
+    switch (header->type) {
+    case ZMK_SPLIT_UART_FRAME_ACK:
+        handle_ack(header->sequence);
+        break;
+    case ZMK_SPLIT_UART_FRAME_RESYNC:
+        LOG_DBG("Central asked for the position state");
+        if (!linked) {
+            linked = true;
+            k_delayed_work_cancel(&retransmit_work);
+            schedule_keepalive();
+        }
+        // Repeated requests while the state is on its way would only fill the window. Otherwise
+        // the central drops everything until the state arrives, so the window is given up.
+        if (!state_frame_in_window()) {
+            window_start = next_sequence;
+            k_delayed_work_cancel(&retransmit_work);
+
+            k_spinlock_key_t key = k_spin_lock(&position_state_lock);
+            position_state_dirty = true;
+            k_spin_unlock(&position_state_lock, key);
+        }
+        send_frames();
+        break;
+    case ZMK_SPLIT_UART_FRAME_CENTRAL_STATE:
+        zmk_split_peripheral_central_state_received(payload, len);
+        send_frame(ZMK_SPLIT_UART_FRAME_ACK, header->sequence, NULL, 0);
+        break;
+    default:
+        LOG_WRN("Unexpected split UART frame type %d", header->type);
+        break;
+    }
+}
+
+static int send_position_event(uint32_t position, bool pressed, int64_t timestamp) {
+    struct zmk_split_uart_position_event event = {
+        .position = sys_cpu_to_le16(position),
+        .pressed = pressed,
+        .timestamp = sys_cpu_to_le16((uint16_t)timestamp),
+    };
+
+    bool overflowed = false;
+
+    k_spinlock_key_t key = k_spin_lock(&position_state_lock);
+    WRITE_BIT(position_state.positions[position / 8], position % 8, pressed);
+    if (!position_state_dirty && k_msgq_put(&position_event_msgq, &event, K_NO_WAIT) != 0) {
+        overflowed = true;
+        position_state_dirty = true;
+    }
+    k_spin_unlock(&position_state_lock, key);
+
+    if (overflowed) {
+        position_event_overflows++;
+        LOG_WRN("Position event queue full (%d overflows so far), sending the full state",
+                position_event_overflows);
+    }
+
+    k_work_submit(&send_frames_work);
+
+    return 0;
+}
+
+int zmk_split_peripheral_position_pressed(uint32_t position, int64_t timestamp) {
+    return send_position_event(position, true, timestamp);
+}
+
+int zmk_split_peripheral_position_released(uint32_t position, int64_t timestamp) {
+    return send_position_event(position, false, timestamp);
+}
+
+static int split_uart_peripheral_init(const struct device *_arg) {
+    k_delayed_work_init(&retransmit_work, retransmit_callback);
+    k_delayed_work_init(&keepalive_work, keepalive_callback);
+
+    int err = zmk_split_uart_link_init(handle_frame);
+    if (err) {
+        return err;
+    }
+
+    // The central may still have keys of a previous run pressed, so start with a reset.
+    return k_delayed_work_submit(&retransmit_work, K_NO_WAIT);
+}
+
+SYS_INIT(split_uart_peripheral_init, APPLICATION, CONFIG_APPLICATION_INIT_PRIORITY);
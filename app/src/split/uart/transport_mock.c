@@ -0,0 +1,63 @@
+/*
+ * Copyright (c) 2020 The ZMK Contributors
+ *
+ * SPDX-License-Identifier: MIT
+ */
+
+#define DT_DRV_COMPAT zmk_split_uart_mock
+
+#include <kernel.h>
+
+#include <logging/log.h>
+
+LOG_MODULE_DECLARE(zmk, CONFIG_ZMK_LOG_LEVEL);
+
+#include <dt-bindings/zmk/split_uart_mock.h>
+#include <zmk/split/uart/transport.h>
+
+#if !DT_HAS_COMPAT_STATUS_OKAY(DT_DRV_COMPAT)
+#error "The mock split UART transport needs a zmk,split-uart-mock node"
+#endif
+
+// Plays back the bytes the other half sends from the devicetree, so tests can drop, split and
+// corrupt frames. Sent bytes go nowhere, the link logs the frames it sends.
+
+static const uint8_t rx_bytes[] = DT_INST_PROP(0, rx_bytes);
+static const uint32_t rx_chunks[] = DT_INST_PROP(0, rx_chunks);
+
+static zmk_split_uart_transport_receive_t receive_callback;
+
+static size_t rx_chunk_index;
+static size_t rx_offset;
+// Uptime the next chunk is due at, so delays do not add up over the chunks.
+static int64_t rx_due;
+static struct k_delayed_work rx_work;
+
+static void schedule_next_chunk() {
+    if (rx_chunk_index < ARRAY_SIZE(rx_chunks)) {
+        rx_due += ZMK_SPLIT_UART_MOCK_MSEC(rx_chunks[rx_chunk_index]);
+        k_delayed_work_submit(&rx_work, K_MSEC(MAX(rx_due - k_uptime_get(), 0)));
+    }
+}
+
+static void rx_work_handler(struct k_work *work) {
+    size_t len = MIN(ZMK_SPLIT_UART_MOCK_LEN(rx_chunks[rx_chunk_index++]),
+                     sizeof(rx_bytes) - rx_offset);
+
+    LOG_DBG("Receiving %d bytes", len);
+    receive_callback(&rx_bytes[rx_offset], len);
+    rx_offset += len;
+
+    schedule_next_chunk();
+}
+
+int zmk_split_uart_transport_send(const uint8_t *data, size_t len) { return 0; }
+
+int zmk_split_uart_transport_init(zmk_split_uart_transport_receive_t receive) {
+    receive_callback = receive;
+
+    k_delayed_work_init(&rx_work, rx_work_handler);
+    rx_due = k_uptime_get();
+    schedule_next_chunk();
+    return 0;
+}
@@ -0,0 +1,131 @@
+/*
+ * Copyright (c) 2020 The ZMK Contributors
+ *
+ * SPDX-License-Identifier: MIT
+ */
+
+#include <device.h>
+#include <kernel.h>
+#include <drivers/uart.h>
+#include <sys/ring_buffer.h>
+
+#include <logging/log.h>
+
+LOG_MODULE_DECLARE(zmk, CONFIG_ZMK_LOG_LEVEL);
+
+#include <zmk/split/uart/protocol.h>
+#include <zmk/split/uart/transport.h>
+
+#if !DT_HAS_CHOSEN(zmk_split_uart)
+#error "The UART split transport needs a zmk,split-uart chosen node"
+#endif
+
+#define SPLIT_UART_LABEL DT_LABEL(DT_CHOSEN(zmk_split_uart))
+
+#define TX_BUFFER_LEN                                                                              \
+    (ZMK_SPLIT_UART_MAX_ENCODED_FRAME_LEN * (CONFIG_ZMK_SPLIT_UART_WINDOW_SIZE + 2))
+#define RX_BUFFER_LEN 32
+#define RX_TIMEOUT_MS 1
+
+static const struct device *uart_dev;
+static zmk_split_uart_transport_receive_t receive_callback;
+
+// Encoded frames waiting to be sent. The UART writes straight out of the buffer, tx_len is the
+// length of the write in progress or 0 if the UART is idle.
+RING_BUF_DECLARE(tx_buffer, TX_BUFFER_LEN);
+static struct k_spinlock tx_lock;
+static uint32_t tx_len;
+
+// The UART switches between the two buffers, one fills while the other one is parsed.
+static uint8_t rx_buffers[2][RX_BUFFER_LEN];
+static int next_rx_buffer;
+
+// Must be called with tx_lock held.
+static void start_tx() {
+    if (tx_len) {
+        return;
+    }
+
+    uint8_t *data;
+    tx_len = ring_buf_get_claim(&tx_buffer, &data, TX_BUFFER_LEN);
+    if (tx_len == 0) {
+        return;
+    }
+
+    int err = uart_tx(uart_dev, data, tx_len, SYS_FOREVER_MS);
+    if (err) {
+        // The peripheral retransmits lost frames, the central sends acks again on the next one.
+        LOG_ERR("Failed to send on the split UART (err %d)", err);
+        ring_buf_get_finish(&tx_buffer, tx_len);
+        tx_len = 0;
+    }
+}
+
+int zmk_split_uart_transport_send(const uint8_t *data, size_t len) {
+    k_spinlock_key_t key = k_spin_lock(&tx_lock);
+
+    if (ring_buf_space_get(&tx_buffer) < len) {
+        k_spin_unlock(&tx_lock, key);
+        return -ENOMEM;
+    }
+
+    ring_buf_put(&tx_buffer, data, len);
+    start_tx();
+
+    k_spin_unlock(&tx_lock, key);
+    return 0;
+}
+
+static int start_rx() {
+    next_rx_buffer = 1;
+    return uart_rx_enable(uart_dev, rx_buffers[0], RX_BUFFER_LEN, RX_TIMEOUT_MS);
+}
+
+static void uart_callback(const struct device *dev, struct uart_event *evt, void *user_data) {
+    switch (evt->type) {
+    case UART_TX_DONE:
+    case UART_TX_ABORTED: {
+        k_spinlock_key_t key = k_spin_lock(&tx_lock);
+        // The rest of an aborted write is dropped, like a frame corrupted on the wire.
+        ring_buf_get_finish(&tx_buffer, tx_len);
+        tx_len = 0;
+        start_tx();
+        k_spin_unlock(&tx_lock, key);
+        break;
+    }
+    case UART_RX_RDY:
+        receive_callback(evt->data.rx.buf + evt->data.rx.offset, evt->data.rx.len);
+        break;
+    case UART_RX_BUF_REQUEST:
+        uart_rx_buf_rsp(dev, rx_buffers[next_rx_buffer], RX_BUFFER_LEN);
+        next_rx_buffer = !next_rx_buffer;
+        break;
+    case UART_RX_STOPPED:
+        LOG_WRN("Split UART receive stopped (reason %d)", evt->data.rx_stop.reason);
+        break;
+    case UART_RX_DISABLED:
+        // After a line error the partial frame fails its CRC, so just start over.
+        start_rx();
+        break;
+    default:
+        break;
+    }
+}
+
+int zmk_split_uart_transport_init(zmk_split_uart_transport_receive_t receive) {
+    receive_callback = receive;
+
+    uart_dev = device_get_binding(SPLIT_UART_LABEL);
+    if (uart_dev == NULL) {
+        LOG_ERR("Unable to find the split UART %s", SPLIT_UART_LABEL);
+        return -ENODEV;
+    }
+
+    int err = uart_callback_set(uart_dev, uart_callback, NULL);
+    if (err) {
+        LOG_ERR("Split UART does not support the async API (err %d)", err);
+        return err;
+    }
+
+    return start_rx();
+}
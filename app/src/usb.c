@@ -6,6 +6,7 @@
 
 #include <device.h>
 #include <init.h>
+#include <sys/atomic.h>
 
 #include <usb/usb_device.h>
 #include <usb/class/usb_hid.h>
@@ -13,6 +14,7 @@
 #include <zmk/hid.h>
 #include <zmk/keymap.h>
 #include <zmk/event_manager.h>
+#include <zmk/event_trace.h>
 #include <zmk/events/usb_conn_state_changed.h>
 
 LOG_MODULE_DECLARE(zmk, CONFIG_ZMK_LOG_LEVEL);
@@ -23,11 +25,163 @@ static enum usb_dc_status_code usb_status = USB_DC_UNKNOWN;
 
 static const struct device *hid_dev;
 
-static K_SEM_DEFINE(hid_sem, 1, 1);
+#if IS_ENABLED(CONFIG_ZMK_USB_BOOT)
 
-static void in_ready_cb(const struct device *dev) { k_sem_give(&hid_sem); }
+static uint8_t hid_protocol = HID_PROTOCOL_REPORT;
+
+static void set_proto_cb(const struct device *dev, uint8_t protocol) { hid_protocol = protocol; }
+
+uint8_t zmk_usb_hid_get_protocol() { return hid_protocol; }
+
+#endif /* IS_ENABLED(CONFIG_ZMK_USB_BOOT) */
+
+#define USB_HID_MAX_REPORT_SIZE                                                                    \
+    MAX(sizeof(struct zmk_hid_keyboard_report), sizeof(struct zmk_hid_consumer_report))
+
+BUILD_ASSERT(USB_HID_MAX_REPORT_SIZE <= CONFIG_HID_INTERRUPT_EP_MPS,
+             "HID reports do not fit in the interrupt endpoint, raise CONFIG_HID_INTERRUPT_EP_MPS");
+
+struct queued_report {
+    uint8_t len;
+    uint8_t data[USB_HID_MAX_REPORT_SIZE];
+    // See zmk_event_trace_report_scan().
+    uint32_t scan_at;
+};
+
+// Reports are queued by the system work queue and sent by whoever sets report_in_flight, which
+// is either the work queue or the IN ready callback chaining the next report. The indices only
+// ever increase, an entry is free once report_queue_tail moved past it.
+static struct queued_report report_queue[CONFIG_ZMK_USB_HID_REPORT_QUEUE_SIZE];
+static atomic_t report_queue_head;
+static atomic_t report_queue_tail;
+static atomic_t report_in_flight;
+
+// Copy of the report being written, so its queue entry can be reused right away.
+static uint8_t in_flight_report[USB_HID_MAX_REPORT_SIZE];
+static uint32_t in_flight_scan_at;
+
+// Latest report per report ID (0 for boot reports) that did not fit in the queue. Reports carry
+// the whole state, so only the intermediate ones are lost and the host still ends up in sync.
+static struct queued_report overflow_reports[3];
+static atomic_t overflow_pending;
+static uint32_t report_queue_overflows;
+
+static bool report_queue_empty() {
+    return atomic_get(&report_queue_head) == atomic_get(&report_queue_tail);
+}
+
+static bool report_queue_full() {
+    return (uint32_t)(atomic_get(&report_queue_head) - atomic_get(&report_queue_tail)) >=
+           CONFIG_ZMK_USB_HID_REPORT_QUEUE_SIZE;
+}
+
+static void push_report(const uint8_t *report, size_t len, uint32_t scan_at) {
+    struct queued_report *entry =
+        &report_queue[(uint32_t)atomic_get(&report_queue_head) % ARRAY_SIZE(report_queue)];
+    memcpy(entry->data, report, len);
+    entry->len = len;
+    entry->scan_at = scan_at;
+    atomic_inc(&report_queue_head);
+}
+
+static int overflow_slot(const uint8_t *report) {
+#if IS_ENABLED(CONFIG_ZMK_USB_BOOT)
+    if (hid_protocol == HID_PROTOCOL_BOOT) {
+        return 0;
+    }
+#endif
+    return report[0] < ARRAY_SIZE(overflow_reports) ? report[0] : 0;
+}
+
+static void queue_report(const uint8_t *report, size_t len) {
+    if (!report_queue_full()) {
+        push_report(report, len, zmk_event_trace_report_scan());
+        return;
+    }
+
+    int slot = overflow_slot(report);
+    report_queue_overflows++;
+    LOG_WRN("USB HID report queue is full (%d overflows so far), holding back report ID %d",
+            report_queue_overflows, slot);
+    memcpy(overflow_reports[slot].data, report, len);
+    overflow_reports[slot].len = len;
+    overflow_reports[slot].scan_at = zmk_event_trace_report_scan();
+    atomic_set_bit(&overflow_pending, slot);
+}
+
+static void queue_overflow_reports() {
+    for (int slot = 0; slot < ARRAY_SIZE(overflow_reports) && !report_queue_full(); slot++) {
+        if (atomic_test_and_clear_bit(&overflow_pending, slot)) {
+            push_report(overflow_reports[slot].data, overflow_reports[slot].len,
+                        overflow_reports[slot].scan_at);
+        }
+    }
+}
+
+static void send_queued_reports() {
+    while (!report_queue_empty()) {
+        if (!atomic_cas(&report_in_flight, 0, 1)) {
+            // Whoever is sending will pick up the report once the current one is written.
+            return;
+        }
+
+        atomic_val_t tail = atomic_get(&report_queue_tail);
+        if (tail == atomic_get(&report_queue_head)) {
+            atomic_clear(&report_in_flight);
+            continue;
+        }
+
+        struct queued_report *entry = &report_queue[(uint32_t)tail % ARRAY_SIZE(report_queue)];
+        size_t len = entry->len;
+        memcpy(in_flight_report, entry->data, len);
+        in_flight_scan_at = entry->scan_at;
+        if (!atomic_cas(&report_queue_tail, tail, tail + 1)) {
+            // The queue was dropped by a bus reset while copying.
+            atomic_clear(&report_in_flight);
+            continue;
+        }
+
+        int err = hid_int_ep_write(hid_dev, in_flight_report, len, NULL);
+        if (err) {
+            LOG_ERR("Failed to write HID report (%d)", err);
+            atomic_clear(&report_in_flight);
+            continue;
+        }
+
+        return;
+    }
+}
+
+static void send_overflow_reports_work(struct k_work *work) {
+    queue_overflow_reports();
+    send_queued_reports();
+}
+
+K_WORK_DEFINE(overflow_reports_work, send_overflow_reports_work);
+
+static void in_ready_cb(const struct device *dev) {
+    if (atomic_clear(&report_in_flight)) {
+        // The host polled the report that was in flight.
+        zmk_event_trace_delivered(in_flight_scan_at);
+    }
+    // Reports are only queued from the system work queue, so hand held back reports over to it.
+    if (atomic_get(&overflow_pending)) {
+        k_work_submit(&overflow_reports_work);
+    }
+    send_queued_reports();
+}
+
+static void reset_report_queue() {
+    atomic_clear(&overflow_pending);
+    atomic_set(&report_queue_tail, atomic_get(&report_queue_head));
+    // A report written before the reset never completes.
+    atomic_clear(&report_in_flight);
+}
 
 static const struct hid_ops ops = {
+#if IS_ENABLED(CONFIG_ZMK_USB_BOOT)
+    .protocol_change = set_proto_cb,
+#endif
     .int_in_ready = in_ready_cb,
 };
 
@@ -41,14 +195,14 @@ int zmk_usb_hid_send_report(const uint8_t *report, size_t len) {
     case USB_DC_UNKNOWN:
         return -ENODEV;
     default:
-        k_sem_take(&hid_sem, K_MSEC(30));
-        int err = hid_int_ep_write(hid_dev, report, len, NULL);
-
-        if (err) {
-            k_sem_give(&hid_sem);
+        if (len > USB_HID_MAX_REPORT_SIZE) {
+            return -EINVAL;
         }
 
-        return err;
+        queue_overflow_reports();
+        queue_report(report, len);
+        send_queued_reports();
+        return 0;
     }
 }
 
@@ -77,6 +231,23 @@ enum zmk_usb_conn_state zmk_usb_get_conn_state() {
 }
 
 void usb_status_cb(enum usb_dc_status_code status, const uint8_t *params) {
+#if IS_ENABLED(CONFIG_ZMK_USB_BOOT)
+    // Hosts start out in the report protocol after a bus reset.
+    if (status == USB_DC_RESET) {
+        hid_protocol = HID_PROTOCOL_REPORT;
+    }
+#endif
+#ifdef CONFIG_ZMK_USB
+    switch (status) {
+    case USB_DC_ERROR:
+    case USB_DC_RESET:
+    case USB_DC_DISCONNECTED:
+        reset_report_queue();
+        break;
+    default:
+        break;
+    }
+#endif /* CONFIG_ZMK_USB */
     usb_status = status;
     raise_usb_status_changed_event();
 };